@@ -63,7 +63,7 @@ std::basic_ostream<Char>& operator << (std::basic_ostream<Char>& out, const Exam
 // Or if you would like to do something more complex depending on the format spec and conversion
 // when a object of your custom class is formatted you can implement your own formatter.
 // You don't need to make it a template class. If you want you just can implement it for char
-// based std::ostream and derive the Formatter class (which is a typedef to BasicFormatter<char>)
+// based writers (Writer) and derive the Formatter class (which is a typedef to BasicFormatter<char>)
 // instead.
 
 // You then need to register your formatter by specializing the format_traits template
@@ -77,7 +77,7 @@ namespace formatstring {
         typedef Example3<Char> value_type;
 
         static inline BasicFormatter<Char> make_formatter(const Example3<Char>& value) {
-            return [&value](std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            return [&value](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
                 std::basic_ostringstream<Char> buffer;
 
                 switch (conv) {
@@ -102,7 +102,7 @@ namespace formatstring {
         typedef T value_type;
 
         static inline BasicFormatter<Char> make_formatter(const T& value) {
-            return [&value](std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            return [&value](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
                 std::basic_ostringstream<Char> buffer;
 
                 switch (conv) {
@@ -121,6 +121,30 @@ namespace formatstring {
     };
 }
 
+// With a formatter specialization a class can have its own format spec letters in typed
+// formats. parse() gets the spec if it isn't a standard one and format() writes the value:
+struct Example4 {
+    int r, g, b;
+};
+
+namespace formatstring {
+    template<>
+    struct formatter<Example4> {
+        bool hex = false;
+
+        void parse(const char* begin, const char* end) {
+            if (std::string(begin, end) != "hex") {
+                throw std::invalid_argument("Example4 only supports the format spec 'hex'");
+            }
+            hex = true;
+        }
+
+        void format(Writer& out, const Example4& value) const {
+            formatstring::format(hex ? "#{:02x}{:02x}{:02x}" : "rgb({}, {}, {})", value.r, value.g, value.b).write_into(out);
+        }
+    };
+}
+
 // string table to support all kinds of string types:
 template<>
 struct strings<char> {
@@ -188,6 +212,8 @@ int main() {
     std::cout << format("{}, {!r}, ptr: {!s}, *ptr: {}, shared_ptr: {}, *shared_ptr: {}\n",
                         Example2("blub"), Example2("bla\nbla"), ptr, *ptr, ptr2, *ptr2);
     std::cout << format("subtype support: {}\n", Example3Sub<char>("Example3Sub"));
+    const auto colors = compile<Example4, Example4, Example4>("custom spec: {} {:hex} {:_>20}\n");
+    std::cout << colors.str(Example4{255, 128, 0}, Example4{255, 128, 0}, Example4{0, 0, 0});
     std::cout.flush();
     std::wcout << format(L"{}\n", ex3_wchar) << std::flush;
     delete ptr;
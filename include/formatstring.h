@@ -6,10 +6,14 @@
 #include "formatstring/conversion.h"
 #include "formatstring/exceptions.h"
 #include "formatstring/format.h"
+#include "formatstring/format_kernel.h"
 #include "formatstring/format_traits.h"
+#include "formatstring/formatcache.h"
 #include "formatstring/formatitem.h"
+#include "formatstring/formatparser.h"
 #include "formatstring/formatspec.h"
 #include "formatstring/formatter.h"
 #include "formatstring/formattedvalue.h"
+#include "formatstring/writer.h"
 
 #endif // FORMMATSTRING_H
@@ -3,7 +3,7 @@
 #pragma once
 
 namespace formatstring {
-    enum Conversion {
+    enum Conversion : unsigned char {
         NoConv,
         StrConv,
         ReprConv
@@ -3,18 +3,29 @@
 #pragma once
 
 #include <string>
-#include <iosfwd>
-#include <sstream>
+#include <ostream>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <type_traits>
 
 #include "formatstring/config.h"
 #include "formatstring/export.h"
 
 #include "formatstring/formatter.h"
+#include "formatstring/format_kernel.h"
 #include "formatstring/formatitem.h"
+#include "formatstring/formatcache.h"
+#include "formatstring/formatparser.h"
+#include "formatstring/writer.h"
+#include "formatstring/exceptions.h"
 
 namespace formatstring {
 
-    template<typename Char>
+    // BasicFormat<Char> takes arguments of any type. BasicFormat<Char, Args...> is compiled
+    // for exactly these argument types (see below).
+    template<typename Char, typename... Args>
     class BasicFormat;
 
     typedef BasicFormat<char> Format;
@@ -29,45 +40,245 @@ namespace formatstring {
 
     typedef BasicFormat<wchar_t> WFormat;
 
-    template<typename Char>
+    template<typename Char, std::size_t N>
     class BasicBoundFormat;
 
+    // Custom specs (for user defined formatters) are only accepted with customSpecs.
     template<typename Char>
-    BasicFormatItems<Char> parse_format(const Char* fmt);
+    BasicFormatItems<Char> parse_format(const Char* fmt, bool customSpecs = false);
 
     template<typename Char>
-    class FORMATSTRING_EXPORT BasicFormat {
+    class FORMATSTRING_EXPORT BasicFormat<Char> {
     public:
         typedef Char char_type;
 
-        BasicFormat(const Char* fmt) : m_fmt(new BasicFormatItems<Char>(std::move(parse_format(fmt)))) {}
+        BasicFormat(const Char* fmt) : m_fmt(std::make_shared<BasicFormatItems<Char>>(parse_format(fmt))) {}
 
         BasicFormat(const std::basic_string<Char>& fmt) : BasicFormat(fmt.c_str()) {}
         BasicFormat(const BasicFormat<Char>& other) : m_fmt(other.m_fmt) {}
+        explicit BasicFormat(const std::shared_ptr<const BasicFormatItems<Char>>& items) : m_fmt(items) {}
+
+        template<typename... Args>
+        inline void format(BasicWriter<Char>& out, const Args&... args) const {
+            const std::array<BasicFormatter<Char>, sizeof...(Args)> formatters = {{format_traits<Char,Args>::make_formatter(args)...}};
+            apply(out, formatters.data(), formatters.size());
+        }
 
         template<typename... Args>
         inline void format(std::basic_ostream<Char>& out, const Args&... args) const {
-            apply(out, {format_traits<Char,Args>::make_formatter(args)...});
+            BasicOStreamWriter<Char> writer(out);
+            format(writer, args...);
+            writer.flush();
+        }
+
+        // Length of the formatted string, without producing it.
+        template<typename... Args>
+        inline std::size_t formatted_size(const Args&... args) const {
+            BasicCountingWriter<Char> writer;
+            format(writer, args...);
+            return writer.size();
         }
 
+        // Writes the formatted string to first, which has to be big enough. No terminating
+        // NUL is written. Returns a pointer past the last written character.
         template<typename... Args>
-        inline BasicBoundFormat<Char> bind(const Args&... args) const;
+        inline Char* format_to(Char* first, const Args&... args) const {
+            BasicPointerWriter<Char> writer(first);
+            format(writer, args...);
+            return writer.pos();
+        }
 
+        // Writes at most n characters of the formatted string to buf. No terminating NUL is
+        // written. Returns the length of the untruncated formatted string.
         template<typename... Args>
-        inline BasicBoundFormat<Char> operator () (const Args&... args) const;
+        inline std::size_t format_to_n(Char* buf, std::size_t n, const Args&... args) const {
+            BasicBufferWriter<Char> writer(buf, n);
+            format(writer, args...);
+            return writer.size();
+        }
 
-        void apply(std::basic_ostream<Char>& out, const BasicFormatters<Char>& formatters) const {
-            for (auto& item : *m_fmt) {
-                item->apply(out, formatters);
+        template<typename... Args>
+        inline BasicBoundFormat<Char, sizeof...(Args)> bind(const Args&... args) const;
+
+        template<typename... Args>
+        inline BasicBoundFormat<Char, sizeof...(Args)> operator () (const Args&... args) const;
+
+        inline const std::shared_ptr<const BasicFormatItems<Char>>& items() const noexcept {
+            return m_fmt;
+        }
+
+        void apply(BasicWriter<Char>& out, const BasicFormatter<Char>* formatters, std::size_t count) const {
+            const BasicFormatItems<Char>& items = *m_fmt;
+            for (const BasicFormatItem<Char>& item : items) {
+                switch (item.type) {
+                case BasicFormatItem<Char>::Literal:
+                    out.write(items.chars(item), item.literal.length);
+                    break;
+
+                case BasicFormatItem<Char>::Value:
+                    if (item.value.index >= count) {
+                        throw InvalidFormatArgumentException(item.value.index);
+                    }
+                    formatters[item.value.index](out, item.conv, items.spec(item));
+                    break;
+                }
             }
         }
 
+        inline void apply(BasicWriter<Char>& out, const BasicFormatters<Char>& formatters) const {
+            apply(out, formatters.data(), formatters.size());
+        }
+
+        void apply(std::basic_ostream<Char>& out, const BasicFormatters<Char>& formatters) const {
+            BasicOStreamWriter<Char> writer(out);
+            apply(writer, formatters);
+            writer.flush();
+        }
+
     private:
         std::shared_ptr<const BasicFormatItems<Char>> m_fmt;
     };
 
-    template<typename Char>
-    class FORMATSTRING_EXPORT BasicBoundFormat {
+    // A format compiled for a fixed list of argument types. Every replacement field is
+    // bound to the formatting function of its argument's type when the format is
+    // compiled, and argument indices and format specs are checked then too. Formatting
+    // just calls these functions, without any further checks or type dispatch:
+    //
+    //     const auto fmt = compile<int, const char*>("{:>8} {}");
+    //     fmt.format_to_n(buf, sizeof(buf), 42, "foo");
+    //
+    // Throws InvalidFormatArgumentException for an index that is out of range and
+    // std::invalid_argument for a spec that can't be used with the argument's type.
+    //
+    // Only typed formats accept custom specs, for arguments with a formatter<T,Char>
+    // (see format_traits_fwd.h). The formatter parses its spec once, right here.
+    template<typename Char, typename First, typename... Rest>
+    class BasicFormat<Char, First, Rest...> {
+    public:
+        typedef Char char_type;
+        typedef void (*kernel_type)(BasicWriter<Char>& out, const void* value, Conversion conv, const void* data);
+        typedef const void* (*bind_type)(Conversion conv, const BasicFormatSpec<Char>& spec, impl::field_states& states);
+
+        static const std::size_t ARGUMENT_COUNT = 1 + sizeof...(Rest);
+
+        BasicFormat(const Char* fmt) : BasicFormat(BasicFormat<Char>(std::make_shared<BasicFormatItems<Char>>(
+                parse_format(fmt, impl::any_formatter<Char, First, Rest...>::value)))) {}
+        BasicFormat(const std::basic_string<Char>& fmt) : BasicFormat(fmt.c_str()) {}
+
+        explicit BasicFormat(const BasicFormat<Char>& format) {
+            static const kernel_type kernels[ARGUMENT_COUNT] = {
+                &impl::field_kernel<Char,First>::apply, &impl::field_kernel<Char,Rest>::apply...
+            };
+            static const bind_type binds[ARGUMENT_COUNT] = {
+                &impl::field_kernel<Char,First>::bind, &impl::field_kernel<Char,Rest>::bind...
+            };
+
+            std::shared_ptr<Program> program = std::make_shared<Program>();
+            program->items = format.items();
+
+            const BasicFormatItems<Char>& items = *program->items;
+            program->fields.reserve(items.size());
+            for (const BasicFormatItem<Char>& item : items) {
+                Field field;
+                switch (item.type) {
+                case BasicFormatItem<Char>::Literal:
+                    field.kernel = nullptr;
+                    field.data   = items.chars(item);
+                    field.index  = item.literal.length;
+                    field.conv   = NoConv;
+                    break;
+
+                case BasicFormatItem<Char>::Value:
+                    if (item.value.index >= ARGUMENT_COUNT) {
+                        throw InvalidFormatArgumentException(item.value.index);
+                    }
+                    field.kernel = kernels[item.value.index];
+                    field.data   = binds[item.value.index](item.conv, items.spec(item), program->states);
+                    field.index  = item.value.index;
+                    field.conv   = item.conv;
+                    break;
+                }
+                program->fields.push_back(field);
+            }
+
+            m_program = std::move(program);
+        }
+
+        void format(BasicWriter<Char>& out, const First& first, const Rest&... rest) const {
+            const void* const values[ARGUMENT_COUNT] = {std::addressof(first), std::addressof(rest)...};
+            for (const Field& field : m_program->fields) {
+                if (field.kernel) {
+                    field.kernel(out, values[field.index], field.conv, field.data);
+                }
+                else {
+                    out.write(static_cast<const Char*>(field.data), field.index);
+                }
+            }
+        }
+
+        inline void format(std::basic_ostream<Char>& out, const First& first, const Rest&... rest) const {
+            BasicOStreamWriter<Char> writer(out);
+            format(writer, first, rest...);
+            writer.flush();
+        }
+
+        inline std::size_t formatted_size(const First& first, const Rest&... rest) const {
+            BasicCountingWriter<Char> writer;
+            format(writer, first, rest...);
+            return writer.size();
+        }
+
+        inline Char* format_to(Char* out, const First& first, const Rest&... rest) const {
+            BasicPointerWriter<Char> writer(out);
+            format(writer, first, rest...);
+            return writer.pos();
+        }
+
+        inline std::size_t format_to_n(Char* buf, std::size_t n, const First& first, const Rest&... rest) const {
+            BasicBufferWriter<Char> writer(buf, n);
+            format(writer, first, rest...);
+            return writer.size();
+        }
+
+        inline std::basic_string<Char> str(const First& first, const Rest&... rest) const {
+            std::basic_string<Char> str(formatted_size(first, rest...), (Char)0);
+            BasicBufferWriter<Char> writer(&str[0], str.size());
+            format(writer, first, rest...);
+            if (writer.size() != str.size()) {
+                // a custom formatter produced a different length the second time
+                str.clear();
+                BasicStringWriter<Char> retry(str);
+                format(retry, first, rest...);
+            }
+            return str;
+        }
+
+    private:
+        // A literal has no kernel, data points to its characters and index is its length.
+        // Otherwise data is what the field was bound to (see impl::field_kernel).
+        struct Field {
+            kernel_type   kernel;
+            const void*   data;
+            std::uint32_t index;
+            Conversion    conv;
+        };
+
+        struct Program {
+            std::shared_ptr<const BasicFormatItems<Char>> items;
+            std::vector<Field> fields;
+            impl::field_states states;
+        };
+
+        std::shared_ptr<const Program> m_program;
+    };
+
+    template<typename Char, typename First, typename... Rest>
+    const std::size_t BasicFormat<Char, First, Rest...>::ARGUMENT_COUNT;
+
+    // A format together with its arguments. The formatters are kept in an array sized by
+    // the number of arguments, so binding does not allocate for built-in argument types.
+    template<typename Char, std::size_t N>
+    class BasicBoundFormat {
     public:
         typedef Char char_type;
 
@@ -75,46 +286,66 @@ namespace formatstring {
         friend class BasicFormat<Char>;
 
         template<typename _Char, typename... Args>
-        friend BasicBoundFormat<_Char> format(const std::basic_string<_Char>& fmt, const Args&... args);
+        friend BasicBoundFormat<_Char, sizeof...(Args)> format(const std::basic_string<_Char>& fmt, const Args&... args);
 
         template<typename _Char, typename... Args>
-        friend BasicBoundFormat<_Char> format(const _Char* fmt, const Args&... args);
+        friend BasicBoundFormat<_Char, sizeof...(Args)> format(const _Char* fmt, const Args&... args);
 
         template<typename _Char, typename... Args>
-        friend BasicBoundFormat<_Char> format(std::basic_string<_Char>&& fmt, Args&&... args);
+        friend BasicBoundFormat<_Char, sizeof...(Args)> format(std::basic_string<_Char>&& fmt, Args&&... args);
 
 #ifndef NDEBUG
         template<typename _Char, typename... Args>
-        friend BasicBoundFormat<_Char> debug(const std::basic_string<_Char>& fmt, const Args&... args);
+        friend BasicBoundFormat<_Char, sizeof...(Args)> debug(const std::basic_string<_Char>& fmt, const Args&... args);
 
         template<typename _Char, typename... Args>
-        friend BasicBoundFormat<_Char> debug(const _Char* fmt, const Args&... args);
+        friend BasicBoundFormat<_Char, sizeof...(Args)> debug(const _Char* fmt, const Args&... args);
 #endif
 
-        BasicBoundFormat(BasicBoundFormat<Char>&& rhs) :
+        BasicBoundFormat(BasicBoundFormat<Char, N>&& rhs) :
             m_format(std::move(rhs.m_format)), m_formatters(std::move(rhs.m_formatters)) {}
 
-        BasicBoundFormat(const BasicBoundFormat<Char>& other) = delete;
+        BasicBoundFormat(const BasicBoundFormat<Char, N>& other) = delete;
 
         template<typename... Args>
         BasicBoundFormat(const BasicFormat<Char>& format, const Args&... args) :
-            m_format(format), m_formatters({format_traits<Char,Args>::make_formatter(args)...}) {}
+            m_format(format), m_formatters({{format_traits<Char,Args>::make_formatter(args)...}}) {}
 
         template<typename... Args>
         BasicBoundFormat(BasicFormat<Char>&& format, const Args&... args) :
-            m_format(std::move(format)), m_formatters({format_traits<Char,Args>::make_formatter(args)...}) {}
+            m_format(std::move(format)), m_formatters({{format_traits<Char,Args>::make_formatter(args)...}}) {}
 
         BasicFormat<Char>& operator= (const BasicFormat<Char>& other) = delete;
 
     public:
+        inline void write_into(BasicWriter<Char>& out) const {
+            m_format.apply(out, m_formatters.data(), N);
+        }
+
         inline void write_into(std::basic_ostream<Char>& out) const {
-            m_format.apply(out, m_formatters);
+            BasicOStreamWriter<Char> writer(out);
+            write_into(writer);
+            writer.flush();
+        }
+
+        inline std::size_t formatted_size() const {
+            BasicCountingWriter<Char> out;
+            write_into(out);
+            return out.size();
         }
 
+        // The size is determined first, so that the string is allocated only once.
         inline operator std::basic_string<Char> () const {
-            std::basic_ostringstream<Char> out;
-            m_format.apply(out, m_formatters);
-            return out.str();
+            std::basic_string<Char> str(formatted_size(), (Char)0);
+            BasicBufferWriter<Char> out(&str[0], str.size());
+            write_into(out);
+            if (out.size() != str.size()) {
+                // a custom formatter produced a different length the second time
+                str.clear();
+                BasicStringWriter<Char> retry(str);
+                write_into(retry);
+            }
+            return str;
         }
 
         inline std::basic_string<Char> str() const {
@@ -123,50 +354,105 @@ namespace formatstring {
 
     private:
         const BasicFormat<Char> m_format;
-        const BasicFormatters<Char> m_formatters;
+        const std::array<BasicFormatter<Char>, N> m_formatters;
     };
 
     template<typename Char>
     template<typename... Args>
-    inline BasicBoundFormat<Char> BasicFormat<Char>::bind(const Args&... args) const {
-        return BasicBoundFormat<Char>(*this, args...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> BasicFormat<Char>::bind(const Args&... args) const {
+        return BasicBoundFormat<Char, sizeof...(Args)>(*this, args...);
     }
 
     template<typename Char>
     template<typename... Args>
-    inline BasicBoundFormat<Char> BasicFormat<Char>::operator () (const Args&... args) const {
+    inline BasicBoundFormat<Char, sizeof...(Args)> BasicFormat<Char>::operator () (const Args&... args) const {
         return bind(args...);
     }
 
-    template<typename Char, typename OStream>
-    inline OStream& operator << (OStream& out, const BasicBoundFormat<Char>& fmt) {
+    template<typename Char, std::size_t N, typename OStream>
+    inline OStream& operator << (OStream& out, const BasicBoundFormat<Char, N>& fmt) {
         fmt.write_into(out);
         return out;
     }
 
+    template<typename Char>
+    inline BasicFormat<Char> compile(const std::basic_string<Char>& fmt) {
+        return fmt;
+    }
+
+    template<typename Char>
+    inline BasicFormat<Char> compile(const Char* fmt) {
+        return fmt;
+    }
+
+    // Typed compile: compile<int, double>("{} {:.2f}"). A single argument of the character
+    // type itself would be ambiguous with compile<Char>(), use the constructor for that.
+    template<typename First, typename... Rest, typename Char,
+             typename = typename std::enable_if<sizeof...(Rest) != 0 || !std::is_same<First, Char>::value>::type>
+    inline BasicFormat<Char, First, Rest...> compile(const std::basic_string<Char>& fmt) {
+        return BasicFormat<Char, First, Rest...>(fmt);
+    }
+
+    template<typename First, typename... Rest, typename Char,
+             typename = typename std::enable_if<sizeof...(Rest) != 0 || !std::is_same<First, Char>::value>::type>
+    inline BasicFormat<Char, First, Rest...> compile(const Char* fmt) {
+        return BasicFormat<Char, First, Rest...>(fmt);
+    }
+
+    // Like compile(), but the parsed format is shared through the process wide format cache.
+    template<typename Char>
+    inline BasicFormat<Char> cached_compile(const std::basic_string<Char>& fmt) {
+        return BasicFormat<Char>(BasicFormatCache<Char>::get(fmt.c_str()));
+    }
+
+    template<typename Char>
+    inline BasicFormat<Char> cached_compile(const Char* fmt) {
+        return BasicFormat<Char>(BasicFormatCache<Char>::get(fmt));
+    }
+
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> format(const std::basic_string<Char>& fmt, const Args&... args) {
-        return BasicBoundFormat<Char>(fmt, args...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> format(const std::basic_string<Char>& fmt, const Args&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), args...);
     }
 
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> format(const Char* fmt, const Args&... args) {
-        return BasicBoundFormat<Char>(fmt, args...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> format(const Char* fmt, const Args&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), args...);
     }
 
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> format(std::basic_string<Char>&& fmt, Args&&... args) {
-        return BasicBoundFormat<Char>(std::move(fmt), std::forward<Args>(args)...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> format(std::basic_string<Char>&& fmt, Args&&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), std::forward<Args>(args)...);
     }
 
-    template<typename Char>
-    inline BasicFormat<Char> compile(const std::basic_string<Char>& fmt) {
-        return fmt;
+    template<typename Char, typename... Args>
+    inline std::size_t formatted_size(const std::basic_string<Char>& fmt, const Args&... args) {
+        return cached_compile(fmt).formatted_size(args...);
     }
 
-    template<typename Char>
-    inline BasicFormat<Char> compile(const Char* fmt) {
-        return fmt;
+    template<typename Char, typename... Args>
+    inline std::size_t formatted_size(const Char* fmt, const Args&... args) {
+        return cached_compile(fmt).formatted_size(args...);
+    }
+
+    template<typename Char, typename... Args>
+    inline Char* format_to(Char* first, const std::basic_string<Char>& fmt, const Args&... args) {
+        return cached_compile(fmt).format_to(first, args...);
+    }
+
+    template<typename Char, typename... Args>
+    inline Char* format_to(Char* first, const Char* fmt, const Args&... args) {
+        return cached_compile(fmt).format_to(first, args...);
+    }
+
+    template<typename Char, typename... Args>
+    inline std::size_t format_to_n(Char* buf, std::size_t n, const std::basic_string<Char>& fmt, const Args&... args) {
+        return cached_compile(fmt).format_to_n(buf, n, args...);
+    }
+
+    template<typename Char, typename... Args>
+    inline std::size_t format_to_n(Char* buf, std::size_t n, const Char* fmt, const Args&... args) {
+        return cached_compile(fmt).format_to_n(buf, n, args...);
     }
 
     // ---- debug ----
@@ -182,11 +468,33 @@ namespace formatstring {
         inline DummyFormat(const Char* fmt) { (void)fmt; }
         inline DummyFormat(const std::basic_string<Char>& fmt) { (void)fmt; }
 
+        template<typename... Args>
+        inline void format(BasicWriter<Char>& out, const Args&...) const {
+            (void)out;
+        }
+
         template<typename... Args>
         inline void format(std::basic_ostream<Char>& out, const Args&...) const {
             (void)out;
         }
 
+        template<typename... Args>
+        inline std::size_t formatted_size(const Args&...) const {
+            return 0;
+        }
+
+        template<typename... Args>
+        inline Char* format_to(Char* first, const Args&...) const {
+            return first;
+        }
+
+        template<typename... Args>
+        inline std::size_t format_to_n(Char* buf, std::size_t n, const Args&...) const {
+            (void)buf;
+            (void)n;
+            return 0;
+        }
+
         template<typename... Args>
         inline DummyBoundFormat<Char> bind(const Args&...) const {
             return DummyBoundFormat<Char>();
@@ -197,6 +505,11 @@ namespace formatstring {
             return DummyBoundFormat<Char>();
         }
 
+        inline void apply(BasicWriter<Char>& out, const BasicFormatters<Char>& formatters) const {
+            (void)out;
+            (void)formatters;
+        }
+
         inline void apply(std::basic_ostream<Char>& out, const BasicFormatters<Char>& formatters) const {
             (void)out;
             (void)formatters;
@@ -225,10 +538,18 @@ namespace formatstring {
             (void)format;
         }
 
+        inline void write_into(BasicWriter<Char>& out) const {
+            (void)out;
+        }
+
         inline void write_into(std::basic_ostream<Char>& out) const {
             (void)out;
         }
 
+        inline std::size_t formatted_size() const {
+            return 0;
+        }
+
         inline operator std::basic_string<Char> () const {
             return std::basic_string<Char>();
         }
@@ -276,18 +597,18 @@ namespace formatstring {
     }
 #else
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> debug(const std::basic_string<Char>& fmt, const Args&... args) {
-        return BasicBoundFormat<Char>(fmt, args...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> debug(const std::basic_string<Char>& fmt, const Args&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), args...);
     }
 
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> debug(const Char* fmt, const Args&... args) {
-        return BasicBoundFormat<Char>(fmt, args...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> debug(const Char* fmt, const Args&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), args...);
     }
 
     template<typename Char, typename... Args>
-    inline BasicBoundFormat<Char> debug(std::basic_string<Char>& fmt, Args&&... args) {
-        return BasicBoundFormat<Char>(std::move(fmt), std::forward<Args>(args)...);
+    inline BasicBoundFormat<Char, sizeof...(Args)> debug(std::basic_string<Char>& fmt, Args&&... args) {
+        return BasicBoundFormat<Char, sizeof...(Args)>(cached_compile(fmt), std::forward<Args>(args)...);
     }
 
     template<typename Char>
@@ -301,58 +622,83 @@ namespace formatstring {
     }
 #endif
 
-    extern template FORMATSTRING_EXPORT FormatItems parse_format<char>(const char* fmt);
+    extern template FORMATSTRING_EXPORT FormatItems parse_format<char>(const char* fmt, bool customSpecs);
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-    extern template FORMATSTRING_EXPORT U16FormatItems parse_format<char16_t>(const char16_t* fmt);
+    extern template FORMATSTRING_EXPORT U16FormatItems parse_format<char16_t>(const char16_t* fmt, bool customSpecs);
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-    extern template FORMATSTRING_EXPORT U32FormatItems parse_format<char32_t>(const char32_t* fmt);
+    extern template FORMATSTRING_EXPORT U32FormatItems parse_format<char32_t>(const char32_t* fmt, bool customSpecs);
 #endif
 
-    extern template FORMATSTRING_EXPORT WFormatItems parse_format<wchar_t>(const wchar_t* fmt);
+    extern template FORMATSTRING_EXPORT WFormatItems parse_format<wchar_t>(const wchar_t* fmt, bool customSpecs);
 
+    extern template class FORMATSTRING_EXPORT BasicFormatItems<char>;
     extern template class FORMATSTRING_EXPORT BasicFormat<char>;
-    extern template class FORMATSTRING_EXPORT BasicBoundFormat<char>;
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicFormatItems<char16_t>;
     extern template class FORMATSTRING_EXPORT BasicFormat<char16_t>;
-    extern template class FORMATSTRING_EXPORT BasicBoundFormat<char16_t>;
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicFormatItems<char32_t>;
     extern template class FORMATSTRING_EXPORT BasicFormat<char32_t>;
-    extern template class FORMATSTRING_EXPORT BasicBoundFormat<char32_t>;
 #endif
 
+    extern template class FORMATSTRING_EXPORT BasicFormatItems<wchar_t>;
     extern template class FORMATSTRING_EXPORT BasicFormat<wchar_t>;
-    extern template class FORMATSTRING_EXPORT BasicBoundFormat<wchar_t>;
 
     // ---- literals ----
+#if defined(__GNUC__)
+    // String literal operator templates are a GNU extension (supported by GCC and clang).
+    // With them "..."_fmt is parsed at compile time into static tables, which the returned
+    // format references without any allocation. Malformed format strings are compile errors.
+#   define FORMATSTRING_STATIC_LITERALS 1
+
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wpedantic"
+#   ifdef __clang__
+#       pragma GCC diagnostic ignored "-Wgnu-string-literal-operator-template"
+#   endif
+
+    template<typename Char, Char... chars>
+    inline BasicFormat<Char> operator "" _fmt () {
+        static constexpr Char fmt[] = {chars..., (Char)0};
+        static constexpr BasicStaticFormat<Char, sizeof...(chars) + 1> parsed(fmt);
+        static const BasicFormatItems<Char> items(parsed.items(), parsed.size(), parsed.specs(), parsed.chars());
+
+        // aliasing constructor without an owner: no reference counting for a static table
+        return BasicFormat<Char>(std::shared_ptr<const BasicFormatItems<Char>>(std::shared_ptr<const BasicFormatItems<Char>>(), &items));
+    }
+
+#   pragma GCC diagnostic pop
+#else
     inline Format operator "" _fmt (const char* fmt, std::size_t size) {
         (void)size;
-        return fmt;
+        return cached_compile(fmt);
     }
 
     inline WFormat operator "" _fmt (const wchar_t* fmt, std::size_t size) {
         (void)size;
-        return fmt;
+        return cached_compile(fmt);
     }
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
     inline U16Format operator "" _fmt (const char16_t* fmt, std::size_t size) {
         (void)size;
-        return fmt;
+        return cached_compile(fmt);
     }
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
     inline U32Format operator "" _fmt (const char32_t* fmt, std::size_t size) {
         (void)size;
-        return fmt;
+        return cached_compile(fmt);
     }
 #endif
+#endif // __GNUC__
 }
 
 #endif // FORMATSTRING_FORMAT_H
@@ -0,0 +1,309 @@
+#ifndef FORMATSTRING_FORMAT_KERNEL_H
+#define FORMATSTRING_FORMAT_KERNEL_H
+#pragma once
+
+#include "formatstring/config.h"
+#include "formatstring/conversion.h"
+#include "formatstring/formatspec.h"
+#include "formatstring/formatvalue.h"
+#include "formatstring/formatter.h"
+#include "formatstring/format_traits.h"
+#include "formatstring/writer.h"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace formatstring {
+
+    // Formatting of an argument whose type is known when a format is compiled, used by
+    // the typed BasicFormat<Char, Args...>:
+    //
+    //   check(conv, spec)               throws if spec can't be used for T (with conv)
+    //   apply(out, value, conv, spec)   formats *(const T*)value
+    //
+    // Built-in types call the formatting functions directly. Everything else goes through
+    // format_traits, which is not checked in advance.
+    template<typename Char, typename T, typename ENABLE = void>
+    struct format_kernel {
+        typedef Char char_type;
+        typedef T value_type;
+
+        static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+            (void)conv;
+            (void)spec;
+        }
+
+        static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            format_traits<Char,T>::make_formatter(*static_cast<const T*>(value))(out, conv, spec);
+        }
+    };
+
+    namespace impl {
+        // format_integer() and friends format 'c' as a string
+        template<typename Char>
+        inline void check_string_type_spec(const BasicFormatSpec<Char>& spec) {
+            BasicFormatSpec<Char> strspec = spec;
+            strspec.type = BasicFormatSpec<Char>::String;
+            check_string_spec(strspec);
+        }
+
+        template<typename Char>
+        inline void check_integer_spec(Conversion conv, const BasicFormatSpec<Char>& spec) {
+            if (conv != NoConv) {
+                check_string_spec(spec);
+            }
+            else if (spec.type == BasicFormatSpec<Char>::Character) {
+                check_string_type_spec(spec);
+            }
+        }
+
+        template<typename Char, typename T, typename Int, typename UInt = typename std::make_unsigned<Int>::type>
+        struct integer_kernel {
+            typedef Char char_type;
+            typedef T value_type;
+
+            static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+                check_integer_spec(conv, spec);
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                format_converted<Char,Int,format_integer<Char,Int,UInt>>(out, *static_cast<const T*>(value), conv, spec);
+            }
+        };
+
+        template<typename Char, typename T>
+        struct char_kernel {
+            typedef Char char_type;
+            typedef T value_type;
+            typedef typename std::char_traits<Char>::int_type int_type;
+
+            static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+                if (conv != NoConv) {
+                    check_string_spec(spec);
+                }
+                else if (spec.type == BasicFormatSpec<Char>::Generic || spec.isStringType()) {
+                    check_string_type_spec(spec);
+                }
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                format_converted<Char,int_type,format_int_char<Char>,repr_int_char<Char,int_type>>(out, *static_cast<const T*>(value), conv, spec);
+            }
+        };
+
+        template<typename Char, typename T>
+        struct float_kernel {
+            typedef Char char_type;
+            typedef T value_type;
+
+            static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+                if (conv != NoConv) {
+                    check_string_spec(spec);
+                }
+                else {
+                    check_float_spec(spec);
+                }
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                format_converted<Char,T,format_float>(out, *static_cast<const T*>(value), conv, spec);
+            }
+        };
+
+        // value points to a const Char* or to the first element of a Char array
+        template<typename Char, typename T, bool pointer>
+        struct string_kernel {
+            typedef Char char_type;
+            typedef T value_type;
+
+            static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+                (void)conv;
+                check_string_spec(spec);
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                const Char* str = pointer ? *static_cast<const Char* const*>(value) : static_cast<const Char*>(value);
+                format_converted<Char,const Char*>(out, str, conv, spec);
+            }
+        };
+    }
+
+    // ---- special characters ----
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    template<>
+    struct format_kernel<char16_t, char16_t> : public impl::char_kernel<char16_t, char16_t> {};
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    template<>
+    struct format_kernel<char32_t, char32_t> : public impl::char_kernel<char32_t, char32_t> {};
+#endif
+
+    template<>
+    struct format_kernel<wchar_t, wchar_t> : public impl::char_kernel<wchar_t, wchar_t> {};
+
+    // ---- boolean ----
+    template<typename Char>
+    struct format_kernel<Char, bool> {
+        typedef Char char_type;
+        typedef bool value_type;
+
+        static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+            if (conv == NoConv && !spec.isNumberType()) {
+                impl::check_string_type_spec(spec);
+            }
+            else {
+                impl::check_integer_spec(conv, spec);
+            }
+        }
+
+        static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            format_converted<Char,bool>(out, *static_cast<const bool*>(value), conv, spec);
+        }
+    };
+
+    // ---- integers ----
+    template<typename Char>
+    struct format_kernel<Char, char> : public impl::char_kernel<Char, char> {};
+
+    template<typename Char>
+    struct format_kernel<Char, signed char> : public impl::char_kernel<Char, signed char> {};
+
+    template<typename Char>
+    struct format_kernel<Char, short> : public impl::integer_kernel<Char, short, int> {};
+
+    template<typename Char>
+    struct format_kernel<Char, int> : public impl::integer_kernel<Char, int, int> {};
+
+    template<typename Char>
+    struct format_kernel<Char, long> : public impl::integer_kernel<Char, long, long long> {};
+
+    template<typename Char>
+    struct format_kernel<Char, long long> : public impl::integer_kernel<Char, long long, long long> {};
+
+    // ---- unsigned integers ----
+    template<typename Char>
+    struct format_kernel<Char, unsigned char> : public impl::char_kernel<Char, unsigned char> {};
+
+    template<typename Char>
+    struct format_kernel<Char, unsigned short> : public impl::integer_kernel<Char, unsigned short, unsigned int> {};
+
+    template<typename Char>
+    struct format_kernel<Char, unsigned int> : public impl::integer_kernel<Char, unsigned int, unsigned int> {};
+
+    template<typename Char>
+    struct format_kernel<Char, unsigned long> : public impl::integer_kernel<Char, unsigned long, unsigned long long> {};
+
+    template<typename Char>
+    struct format_kernel<Char, unsigned long long> : public impl::integer_kernel<Char, unsigned long long, unsigned long long> {};
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+    // ---- 128 bit integers ----
+    template<typename Char>
+    struct format_kernel<Char, int128> : public impl::integer_kernel<Char, int128, int128, uint128> {};
+
+    template<typename Char>
+    struct format_kernel<Char, uint128> : public impl::integer_kernel<Char, uint128, uint128, uint128> {};
+#endif
+
+    // ---- floating point ----
+    template<typename Char>
+    struct format_kernel<Char, float> : public impl::float_kernel<Char, float> {};
+
+    template<typename Char>
+    struct format_kernel<Char, double> : public impl::float_kernel<Char, double> {};
+
+    template<typename Char>
+    struct format_kernel<Char, long double> : public impl::float_kernel<Char, long double> {};
+
+    // ---- string ----
+    template<typename Char>
+    struct format_kernel<Char, const Char*> : public impl::string_kernel<Char, const Char*, true> {};
+
+    template<typename Char, std::size_t N>
+    struct format_kernel<Char, const Char[N]> : public impl::string_kernel<Char, const Char[N], false> {};
+
+    template<typename Char, std::size_t N>
+    struct format_kernel<Char, Char[N]> : public impl::string_kernel<Char, Char[N], false> {};
+
+    template<typename Char>
+    struct format_kernel< Char, std::basic_string<Char> > {
+        typedef Char char_type;
+        typedef std::basic_string<Char> value_type;
+
+        static inline void check(Conversion conv, const BasicFormatSpec<Char>& spec) {
+            (void)conv;
+            check_string_spec(spec);
+        }
+
+        static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            format_converted<Char,const value_type&>(out, *static_cast<const value_type*>(value), conv, spec);
+        }
+    };
+
+    // ---- fields of typed formats ----
+    namespace impl {
+        typedef std::vector< std::shared_ptr<const void> > field_states;
+
+        // Binds a replacement field of BasicFormat<Char, Args...> to the type of its argument
+        // when the format is compiled. bind() checks the spec and returns the data apply()
+        // gets: the spec itself, or for a user defined formatter<T,Char> the formatter that
+        // has parsed the spec. states keeps the formatter alive.
+        template<typename Char, typename T, bool user = has_formatter<T,Char>::value>
+        struct field_kernel {
+            static const void* bind(Conversion conv, const BasicFormatSpec<Char>& spec, field_states& states) {
+                (void)states;
+                if (spec.type == BasicFormatSpec<Char>::Custom) {
+                    throw std::invalid_argument("Custom format spec for an argument type without formatter");
+                }
+                format_kernel<Char,T>::check(conv, spec);
+                return &spec;
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const void* data) {
+                format_kernel<Char,T>::apply(out, value, conv, *static_cast<const BasicFormatSpec<Char>*>(data));
+            }
+        };
+
+        template<typename Char, typename T>
+        struct field_kernel<Char, T, true> {
+            struct state_type {
+                formatter<T,Char> userFormatter;
+                const BasicFormatSpec<Char>* spec;
+            };
+
+            static const void* bind(Conversion conv, const BasicFormatSpec<Char>& spec, field_states& states) {
+                (void)conv;
+                std::shared_ptr<state_type> state = std::make_shared<state_type>();
+                state->spec = &spec;
+                if (spec.type == BasicFormatSpec<Char>::Custom) {
+                    state->userFormatter.parse(spec.custom, spec.custom + spec.customLength);
+                }
+                else {
+                    check_string_spec(spec);
+                }
+                states.push_back(state);
+                return state.get();
+            }
+
+            static void apply(BasicWriter<Char>& out, const void* value, Conversion conv, const void* data) {
+                (void)conv;
+                const state_type& state = *static_cast<const state_type*>(data);
+                format_user_value(out, state.userFormatter, *static_cast<const T*>(value), *state.spec);
+            }
+        };
+
+        // whether any of Args has a formatter<T,Char>, only then a typed format accepts custom specs
+        template<typename Char, typename... Args>
+        struct any_formatter : public std::false_type {};
+
+        template<typename Char, typename First, typename... Rest>
+        struct any_formatter<Char, First, Rest...> :
+            public std::integral_constant<bool, has_formatter<First,Char>::value || any_formatter<Char, Rest...>::value> {};
+    }
+}
+
+#endif // FORMATSTRING_FORMAT_KERNEL_H
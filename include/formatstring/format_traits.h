@@ -21,14 +21,33 @@ namespace formatstring {
     template<typename Derived, typename Base>
     using for_derived = typename std::enable_if<std::is_base_of<Base, Derived>::value>::type;
 
-    // ---- fallback ----
+    namespace impl {
+        // whether formatter<T,Char> is specialized (a complete type)
+        template<typename T, typename Char, typename ENABLE = void>
+        struct has_formatter : public std::false_type {};
+
+        template<typename T, typename Char>
+        struct has_formatter<T, Char, decltype((void)sizeof(formatter<T,Char>))> : public std::true_type {};
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_default_formatter(const T& value, std::true_type) {
+            return make_user_formatter<Char,T>(&value);
+        }
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_default_formatter(const T& value, std::false_type) {
+            return make_fallback_formatter<Char,T>(&value);
+        }
+    }
+
+    // ---- fallback: formatter<T,Char> or operator<< ----
     template<typename Char, typename T, typename ENABLE>
     struct format_traits {
         typedef Char char_type;
         typedef T value_type;
 
         static inline BasicFormatter<Char> make_formatter(const T& value) {
-            return make_fallback_formatter<Char,T>(&value);
+            return impl::make_default_formatter<Char,T>(value, impl::has_formatter<T,Char>());
         }
     };
 
@@ -39,8 +58,8 @@ namespace formatstring {
         typedef char16_t char_type;
         typedef char16_t value_type;
 
-        static inline BasicFormatter<Char> make_formatter(char16_t value) {
-            return make_value_formatter<char16_t,char16_t,format_char<char16_t,char16_t>,repr_char<char16_t>>(value);
+        static inline BasicFormatter<char16_t> make_formatter(char16_t value) {
+            return BasicFormatter<char16_t>::from_char(value);
         }
     };
 #endif
@@ -52,8 +71,8 @@ namespace formatstring {
         typedef char32_t char_type;
         typedef char32_t value_type;
 
-        static inline BasicFormatter<Char> make_formatter(char32_t value) {
-            return make_value_formatter<char32_t,char32_t,format_char<char32_t,char32_t>,repr_char<char32_t>>(value);
+        static inline BasicFormatter<char32_t> make_formatter(char32_t value) {
+            return BasicFormatter<char32_t>::from_char(value);
         }
     };
 #endif
@@ -64,7 +83,7 @@ namespace formatstring {
         typedef wchar_t value_type;
 
         static inline BasicFormatter<wchar_t> make_formatter(wchar_t value) {
-            return make_value_formatter<wchar_t,wchar_t,format_char<wchar_t,wchar_t>,repr_char<wchar_t>>(value);
+            return BasicFormatter<wchar_t>::from_char(value);
         }
     };
 
@@ -75,7 +94,7 @@ namespace formatstring {
         typedef bool value_type;
 
         static inline BasicFormatter<Char> make_formatter(bool value) {
-            return make_value_formatter<Char,bool>(value);
+            return BasicFormatter<Char>::from_bool(value);
         }
     };
 
@@ -86,7 +105,7 @@ namespace formatstring {
         typedef char value_type;
 
         static inline BasicFormatter<Char> make_formatter(char value) {
-            return make_value_formatter<Char,char,format_char<char,char>,repr_char<char>>(value);
+            return BasicFormatter<Char>::from_char(value);
         }
     };
 
@@ -96,7 +115,7 @@ namespace formatstring {
         typedef signed char value_type;
 
         static inline BasicFormatter<Char> make_formatter(signed char value) {
-            return make_value_formatter<Char,signed char,format_char<char,signed char>,repr_int_char<char,signed char>>(value);
+            return BasicFormatter<Char>::from_char(value);
         }
     };
 
@@ -106,7 +125,7 @@ namespace formatstring {
         typedef short value_type;
 
         static inline BasicFormatter<Char> make_formatter(short value) {
-            return make_value_formatter<Char,short,format_integer>(value);
+            return BasicFormatter<Char>::from_int((int)value);
         }
     };
 
@@ -116,7 +135,7 @@ namespace formatstring {
         typedef int value_type;
 
         static inline BasicFormatter<Char> make_formatter(int value) {
-            return make_value_formatter<Char,int,format_integer>(value);
+            return BasicFormatter<Char>::from_int(value);
         }
     };
 
@@ -126,7 +145,7 @@ namespace formatstring {
         typedef long value_type;
 
         static inline BasicFormatter<Char> make_formatter(long value) {
-            return make_value_formatter<Char,long,format_integer>(value);
+            return BasicFormatter<Char>::from_int((long long)value);
         }
     };
 
@@ -136,7 +155,7 @@ namespace formatstring {
         typedef long long value_type;
 
         static inline BasicFormatter<Char> make_formatter(long long value) {
-            return make_value_formatter<Char,long long,format_integer>(value);
+            return BasicFormatter<Char>::from_int(value);
         }
     };
 
@@ -147,7 +166,7 @@ namespace formatstring {
         typedef unsigned char value_type;
 
         static inline BasicFormatter<Char> make_formatter(unsigned char value) {
-            return make_value_formatter<Char,unsigned char,format_char<char,unsigned char>,repr_int_char<char,unsigned char>>(value);
+            return BasicFormatter<Char>::from_char(value);
         }
     };
 
@@ -157,7 +176,7 @@ namespace formatstring {
         typedef unsigned short value_type;
 
         static inline BasicFormatter<Char> make_formatter(unsigned short value) {
-            return make_value_formatter<Char,unsigned short,format_integer>(value);
+            return BasicFormatter<Char>::from_int((unsigned int)value);
         }
     };
 
@@ -167,7 +186,7 @@ namespace formatstring {
         typedef unsigned int value_type;
 
         static inline BasicFormatter<Char> make_formatter(unsigned int value) {
-            return make_value_formatter<Char,unsigned int,format_integer>(value);
+            return BasicFormatter<Char>::from_int(value);
         }
     };
 
@@ -177,7 +196,7 @@ namespace formatstring {
         typedef unsigned long value_type;
 
         static inline BasicFormatter<Char> make_formatter(unsigned long value) {
-            return make_value_formatter<Char,unsigned long,format_integer>(value);
+            return BasicFormatter<Char>::from_int((unsigned long long)value);
         }
     };
 
@@ -187,10 +206,33 @@ namespace formatstring {
         typedef unsigned long long value_type;
 
         static inline BasicFormatter<Char> make_formatter(unsigned long long value) {
-            return make_value_formatter<Char,unsigned long long,format_integer>(value);
+            return BasicFormatter<Char>::from_int(value);
+        }
+    };
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+    // ---- 128 bit integers ----
+    template<typename Char>
+    struct format_traits<Char, int128> {
+        typedef Char char_type;
+        typedef int128 value_type;
+
+        static inline BasicFormatter<Char> make_formatter(int128 value) {
+            return BasicFormatter<Char>::from_int(value);
         }
     };
 
+    template<typename Char>
+    struct format_traits<Char, uint128> {
+        typedef Char char_type;
+        typedef uint128 value_type;
+
+        static inline BasicFormatter<Char> make_formatter(uint128 value) {
+            return BasicFormatter<Char>::from_int(value);
+        }
+    };
+#endif
+
     // ---- floating point ----
     template<typename Char>
     struct format_traits<Char, float> {
@@ -198,7 +240,7 @@ namespace formatstring {
         typedef float value_type;
 
         static inline BasicFormatter<Char> make_formatter(float value) {
-            return make_value_formatter<Char,float,format_float>(value);
+            return BasicFormatter<Char>::from_float(value);
         }
     };
 
@@ -208,7 +250,7 @@ namespace formatstring {
         typedef double value_type;
 
         static inline BasicFormatter<Char> make_formatter(double value) {
-            return make_value_formatter<Char,double,format_float>(value);
+            return BasicFormatter<Char>::from_float(value);
         }
     };
 
@@ -218,18 +260,28 @@ namespace formatstring {
         typedef long double value_type;
 
         static inline BasicFormatter<Char> make_formatter(long double value) {
-            return make_value_formatter<Char,long double,format_float>(value);
+            return BasicFormatter<Char>::from_float(value);
         }
     };
 
     // ---- string ----
+    namespace impl {
+        // Character arrays are often buffers holding a shorter string, so the string ends at
+        // the first null character, but never reads past the array.
+        template<typename Char>
+        inline std::size_t array_string_length(const Char value[], std::size_t size) {
+            const Char* end = std::char_traits<Char>::find(value, size, Char());
+            return end ? end - value : size;
+        }
+    }
+
     template<typename Char>
     struct format_traits<Char, const Char[]> {
         typedef Char char_type;
         typedef const Char value_type[];
 
         static inline BasicFormatter<Char> make_formatter(const Char value[]) {
-            return make_value_formatter<Char,const Char*>(value);
+            return BasicFormatter<Char>::from_string(value);
         }
     };
 
@@ -239,7 +291,7 @@ namespace formatstring {
         typedef Char value_type[];
 
         static inline BasicFormatter<Char> make_formatter(const Char value[]) {
-            return make_value_formatter<Char,const Char*>(value);
+            return BasicFormatter<Char>::from_string(value);
         }
     };
 
@@ -249,7 +301,7 @@ namespace formatstring {
         typedef const Char value_type[N];
 
         static inline BasicFormatter<Char> make_formatter(const Char value[]) {
-            return make_value_formatter<Char,const Char*>(value);
+            return BasicFormatter<Char>::from_string(value, impl::array_string_length(value, N));
         }
     };
 
@@ -259,7 +311,7 @@ namespace formatstring {
         typedef Char value_type[N];
 
         static inline BasicFormatter<Char> make_formatter(const Char value[]) {
-            return make_value_formatter<Char,const Char*>(value);
+            return BasicFormatter<Char>::from_string(value, impl::array_string_length(value, N));
         }
     };
 
@@ -269,7 +321,7 @@ namespace formatstring {
         typedef const Char* value_type;
 
         static inline BasicFormatter<Char> make_formatter(const Char* value) {
-            return make_value_formatter<Char,const Char*>(value);
+            return BasicFormatter<Char>::from_string(value);
         }
     };
 
@@ -279,10 +331,50 @@ namespace formatstring {
         typedef std::basic_string<Char> value_type;
 
         static inline BasicFormatter<Char> make_formatter(const value_type& value) {
-            return make_ptr_formatter<Char,value_type>(&value);
+            return BasicFormatter<Char>::from_string(value.data(), value.size());
         }
     };
 
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    template<typename Char>
+    struct format_traits< Char, std::basic_string_view<Char> > {
+        typedef Char char_type;
+        typedef std::basic_string_view<Char> value_type;
+
+        static inline BasicFormatter<Char> make_formatter(value_type value) {
+            return BasicFormatter<Char>::from_string(value.data(), value.size());
+        }
+    };
+#endif
+
+    namespace impl {
+        // contiguous numbers are formatted with format_each()
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_array_formatter(const T* begin, const T* end, std::true_type) {
+            return make_slice_formatter<Char,const T*,'[',']',format_array,repr_array>(begin, end);
+        }
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_array_formatter(const T* begin, const T* end, std::false_type) {
+            return make_slice_formatter<Char,const T*>(begin, end);
+        }
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_array_formatter(const T* begin, const T* end) {
+            return make_array_formatter<Char,T>(begin, end, is_plain_number<T>());
+        }
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_vector_formatter(const std::vector<T>& value, std::true_type) {
+            return make_array_formatter<Char,T>(value.data(), value.data() + value.size(), std::true_type());
+        }
+
+        template<typename Char, typename T>
+        inline BasicFormatter<Char> make_vector_formatter(const std::vector<T>& value, std::false_type) {
+            return make_slice_formatter<Char,typename std::vector<T>::const_iterator>(value.begin(), value.end());
+        }
+    }
+
     // ---- array ----
     template<typename Char, typename T, std::size_t N>
     struct format_traits<Char, const T[N]> {
@@ -290,7 +382,7 @@ namespace formatstring {
         typedef const T value_type[N];
 
         static inline BasicFormatter<Char> make_formatter(const T value[]) {
-            return make_slice_formatter<Char,const T*>(value, value + N);
+            return impl::make_array_formatter<Char,T>(value, value + N);
         }
     };
 
@@ -300,7 +392,7 @@ namespace formatstring {
         typedef T value_type[N];
 
         static inline BasicFormatter<Char> make_formatter(const T value[]) {
-            return make_slice_formatter<Char,const T*>(value, value + N);
+            return impl::make_array_formatter<Char,T>(value, value + N);
         }
     };
 
@@ -311,7 +403,7 @@ namespace formatstring {
         typedef std::vector<T> value_type;
 
         static inline BasicFormatter<Char> make_formatter(const value_type& value) {
-            return make_slice_formatter<Char,typename value_type::const_iterator>(value.begin(), value.end());
+            return impl::make_vector_formatter<Char,T>(value, impl::is_plain_number<T>());
         }
     };
 
@@ -331,7 +423,7 @@ namespace formatstring {
         typedef std::array<T,N> value_type;
 
         static inline BasicFormatter<Char> make_formatter(const value_type& value) {
-            return make_slice_formatter<Char,typename value_type::const_iterator>(value.begin(), value.end());
+            return impl::make_array_formatter<Char,T>(value.data(), value.data() + N);
         }
     };
 
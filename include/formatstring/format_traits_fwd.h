@@ -7,6 +7,26 @@ namespace formatstring {
     template<typename Char, typename T, typename ENABLE = void>
     struct format_traits;
 
+    // Specialize this to give a type its own format spec mini-language. Types without a
+    // format_traits specialization use it instead of operator<<:
+    //
+    //     template<>
+    //     struct formatter<Date> {
+    //         // the text of a spec that is not a standard one, e.g. "%Y-%m-%d"
+    //         void parse(const char* begin, const char* end);
+    //
+    //         void format(Writer& out, const Date& value) const;
+    //     };
+    //
+    // Custom specs are only accepted by typed formats, e.g. compile<Date>("{:%Y-%m-%d}"),
+    // which default construct a formatter for every such field and call parse() once when
+    // the format is compiled. format() then writes the whole field. Other formats reject
+    // specs that aren't standard ones when they are parsed. With a standard spec (like
+    // "_>20") or none parse() isn't called and the output of format() is aligned like a
+    // string. The conversions !r and !s make no difference.
+    template<typename T, typename Char = char>
+    struct formatter;
+
 }
 
 #endif // FORMATSTRING_FORMAT_TRAITS_FWD_H
@@ -0,0 +1,71 @@
+#ifndef FORMATSTRING_FORMATCACHE_H
+#define FORMATSTRING_FORMATCACHE_H
+#pragma once
+
+#include "formatstring/config.h"
+#include "formatstring/export.h"
+#include "formatstring/formatitem.h"
+
+#include <cstddef>
+#include <memory>
+
+namespace formatstring {
+
+    // Process wide cache of parsed format strings, used by format(fmt, args...) and the
+    // other convenience functions that take a format string instead of a compiled format.
+    //
+    // Every thread first looks the format string up by its address in a small thread local
+    // table, which needs no synchronization. Only if that fails the string is hashed and
+    // looked up in a shared table. Both tables are fixed size and evict on collision.
+    // Entries always compare the string contents too, so reusing a buffer for a different
+    // format string is safe.
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicFormatCache {
+    public:
+        typedef Char char_type;
+        typedef std::shared_ptr<const BasicFormatItems<Char>> items_type;
+
+        static const std::size_t LOCAL_SIZE  = 64;
+        static const std::size_t SHARED_SIZE = 1024;
+
+        BasicFormatCache() = delete;
+
+        // Parsed form of fmt. Throws InvalidFormatStringException for malformed format strings,
+        // which are not cached.
+        static items_type get(const Char* fmt);
+
+        // Lookups that were answered from the cache/had to parse the format string.
+        static std::size_t hits();
+        static std::size_t misses() noexcept;
+
+        // Drops all cached entries (formats that are still in use stay valid).
+        static void clear();
+    };
+
+    typedef BasicFormatCache<char> FormatCache;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    typedef BasicFormatCache<char16_t> U16FormatCache;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    typedef BasicFormatCache<char32_t> U32FormatCache;
+#endif
+
+    typedef BasicFormatCache<wchar_t> WFormatCache;
+
+    // ---- extern template instantiations ----
+    extern template class FORMATSTRING_EXPORT BasicFormatCache<char>;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicFormatCache<char16_t>;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicFormatCache<char32_t>;
+#endif
+
+    extern template class FORMATSTRING_EXPORT BasicFormatCache<wchar_t>;
+}
+
+#endif // FORMATSTRING_FORMATCACHE_H
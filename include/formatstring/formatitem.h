@@ -2,25 +2,175 @@
 #define FORMATSTRING_FORMATITEM_H
 #pragma once
 
-#include "formatstring/formatter.h"
+#include "formatstring/config.h"
+#include "formatstring/export.h"
+#include "formatstring/conversion.h"
+#include "formatstring/formatspec.h"
 
-#include <iosfwd>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
 #include <vector>
-#include <memory>
 
 namespace formatstring {
 
+    // One instruction of a compiled format string. Literal items reference a range of the
+    // character pool of the owning BasicFormatItems, value items reference an argument and
+    // a (deduplicated) entry of its spec table.
     template<typename Char>
-    class BasicFormatItem {
-    public:
+    struct BasicFormatItem {
         typedef Char char_type;
 
-        virtual ~BasicFormatItem() {}
-        virtual void apply(std::basic_ostream<Char>& out, const BasicFormatters<Char>& formatters) const = 0;
+        enum Type : unsigned char {
+            Literal,
+            Value
+        };
+
+        struct LiteralData {
+            std::uint32_t offset;
+            std::uint32_t length;
+        };
+
+        struct ValueData {
+            std::uint32_t index;
+            std::uint32_t spec;
+        };
+
+        Type       type;
+        Conversion conv;
+        union {
+            LiteralData literal;
+            ValueData   value;
+        };
+
+        constexpr BasicFormatItem() noexcept :
+            type(Literal), conv(NoConv), literal{0, 0} {}
+
+        constexpr BasicFormatItem(LiteralData data) noexcept :
+            type(Literal), conv(NoConv), literal(data) {}
+
+        constexpr BasicFormatItem(Conversion valueConv, ValueData data) noexcept :
+            type(Value), conv(valueConv), value(data) {}
     };
 
+    // A compiled format string. Items, specs and literal characters all live in one
+    // contiguous allocation: [items][specs][chars]. The text of custom specs is copied
+    // behind the literal characters. Formats parsed at compile time use a non-owning
+    // view of their static tables instead.
     template<typename Char>
-    using BasicFormatItems = std::vector< std::unique_ptr< BasicFormatItem<Char> > >;
+    class FORMATSTRING_EXPORT BasicFormatItems {
+    public:
+        typedef Char char_type;
+        typedef BasicFormatItem<Char> item_type;
+        typedef BasicFormatSpec<Char> spec_type;
+        typedef const item_type* const_iterator;
+
+        BasicFormatItems() noexcept :
+            m_data(nullptr), m_items(nullptr), m_specs(nullptr), m_chars(nullptr), m_size(0) {}
+
+        constexpr BasicFormatItems(const item_type* items, std::size_t size, const spec_type* specs, const Char* chars) noexcept :
+            m_data(nullptr), m_items(items), m_specs(specs), m_chars(chars), m_size(size) {}
+
+        BasicFormatItems(const std::vector<item_type>& items, const std::vector<spec_type>& specs, const std::basic_string<Char>& chars) :
+                BasicFormatItems() {
+            std::size_t customLength = 0;
+            for (const spec_type& spec : specs) {
+                customLength += spec.customLength;
+            }
+
+            const std::size_t specsOffset = align(items.size() * sizeof(item_type), alignof(spec_type));
+            const std::size_t charsOffset = align(specsOffset + specs.size() * sizeof(spec_type), alignof(Char));
+            const std::size_t size = charsOffset + (chars.size() + customLength) * sizeof(Char);
+
+            if (size == 0) {
+                return;
+            }
+
+            m_data  = static_cast<char*>(::operator new(size));
+            m_items = reinterpret_cast<item_type*>(m_data);
+            m_specs = reinterpret_cast<spec_type*>(m_data + specsOffset);
+            m_chars = reinterpret_cast<Char*>(m_data + charsOffset);
+            m_size  = items.size();
+
+            if (!items.empty()) {
+                std::memcpy(m_data, items.data(), items.size() * sizeof(item_type));
+            }
+
+            Char* custom = reinterpret_cast<Char*>(m_data + charsOffset) + chars.size();
+            for (std::size_t i = 0; i < specs.size(); ++ i) {
+                spec_type* spec = new (m_data + specsOffset + i * sizeof(spec_type)) spec_type(specs[i]);
+                if (spec->customLength > 0) {
+                    std::char_traits<Char>::copy(custom, spec->custom, spec->customLength);
+                    spec->custom = custom;
+                    custom += spec->customLength;
+                }
+            }
+
+            std::char_traits<Char>::copy(reinterpret_cast<Char*>(m_data + charsOffset), chars.data(), chars.size());
+        }
+
+        BasicFormatItems(BasicFormatItems<Char>&& other) noexcept :
+                m_data(other.m_data), m_items(other.m_items), m_specs(other.m_specs),
+                m_chars(other.m_chars), m_size(other.m_size) {
+            other.m_data  = nullptr;
+            other.m_items = nullptr;
+            other.m_specs = nullptr;
+            other.m_chars = nullptr;
+            other.m_size  = 0;
+        }
+
+        BasicFormatItems(const BasicFormatItems<Char>& other) = delete;
+
+        ~BasicFormatItems() {
+            ::operator delete(m_data);
+        }
+
+        BasicFormatItems<Char>& operator= (BasicFormatItems<Char>&& other) noexcept {
+            if (this != &other) {
+                ::operator delete(m_data);
+                m_data  = other.m_data;
+                m_items = other.m_items;
+                m_specs = other.m_specs;
+                m_chars = other.m_chars;
+                m_size  = other.m_size;
+                other.m_data  = nullptr;
+                other.m_items = nullptr;
+                other.m_specs = nullptr;
+                other.m_chars = nullptr;
+                other.m_size  = 0;
+            }
+            return *this;
+        }
+
+        BasicFormatItems<Char>& operator= (const BasicFormatItems<Char>& other) = delete;
+
+        inline const_iterator begin() const noexcept { return m_items; }
+        inline const_iterator end()   const noexcept { return m_items + m_size; }
+        inline std::size_t    size()  const noexcept { return m_size; }
+        inline bool           empty() const noexcept { return m_size == 0; }
+
+        inline const item_type& operator[] (std::size_t index) const noexcept { return m_items[index]; }
+
+        inline const spec_type& spec(const item_type& item) const noexcept {
+            return m_specs[item.value.spec];
+        }
+
+        inline const Char* chars(const item_type& item) const noexcept {
+            return m_chars + item.literal.offset;
+        }
+
+    private:
+        static inline std::size_t align(std::size_t size, std::size_t alignment) noexcept {
+            return (size + alignment - 1) & ~(alignment - 1);
+        }
+
+        char*            m_data;
+        const item_type* m_items;
+        const spec_type* m_specs;
+        const Char*      m_chars;
+        std::size_t      m_size;
+    };
 
     typedef BasicFormatItem<char> FormatItem;
     typedef BasicFormatItem<wchar_t> WFormatItem;
@@ -0,0 +1,454 @@
+#ifndef FORMATSTRING_FORMATPARSER_H
+#define FORMATSTRING_FORMATPARSER_H
+#pragma once
+
+#include "formatstring/config.h"
+#include "formatstring/export.h"
+#include "formatstring/conversion.h"
+#include "formatstring/formatspec.h"
+#include "formatstring/formatitem.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace formatstring {
+
+    namespace impl {
+        // These throw the exceptions of a malformed format string. They are not constexpr,
+        // so reaching one of them while parsing at compile time is a compile error.
+        [[noreturn]] FORMATSTRING_EXPORT void invalid_format_string(std::size_t pos, const char* what);
+        [[noreturn]] FORMATSTRING_EXPORT void invalid_format_spec(const char* what);
+        [[noreturn]] FORMATSTRING_EXPORT void invalid_format_spec(char option, char type);
+
+        template<typename Char>
+        constexpr const Char* parse_size(const Char* ptr, std::size_t* numberptr) {
+            std::size_t number = 0;
+
+            // TODO: handle integer overflow
+            for (; *ptr; ++ ptr) {
+                char ch = *ptr;
+                if (ch < '0' || ch > '9') {
+                    break;
+                }
+                number *= 10;
+                number += ch - '0';
+            }
+
+            *numberptr = number;
+
+            return ptr;
+        }
+
+        // With customSpecs a spec the standard grammar doesn't cover becomes a Custom spec,
+        // otherwise parsing stops where the grammar does.
+        template<typename Char>
+        constexpr const Char* parse_spec_internal(const Char* fmt, const Char* ptr, BasicFormatSpec<Char>* spec, bool customSpecs = false) {
+            typedef BasicFormatSpec<Char> Spec;
+
+            if (!*ptr) {
+                return ptr;
+            }
+
+            const Char* start = ptr;
+            bool precision = false;
+            bool fill = false;
+
+            switch (*(ptr + 1)) {
+            case '<':
+                spec->alignment = Spec::Left;
+                spec->fill = *ptr;
+                fill = true;
+                ptr += 2;
+                break;
+
+            case '>':
+                spec->alignment = Spec::Right;
+                spec->fill = *ptr;
+                fill = true;
+                ptr += 2;
+                break;
+
+            case '=':
+                spec->alignment = Spec::AfterSign;
+                spec->fill = *ptr;
+                fill = true;
+                ptr += 2;
+                break;
+
+            case '^':
+                spec->alignment = Spec::Center;
+                spec->fill = *ptr;
+                fill = true;
+                ptr += 2;
+                break;
+            }
+
+            switch (*ptr) {
+            case '+':
+                spec->sign = Spec::Always;
+                ++ ptr;
+                break;
+
+            case '-':
+                spec->sign = Spec::NegativeOnly;
+                ++ ptr;
+                break;
+
+            case ' ':
+                spec->sign = Spec::SpaceForPositive;
+                ++ ptr;
+                break;
+            }
+
+            if (*ptr == '#') {
+                spec->alternate = true;
+                ++ ptr;
+            }
+
+            if (*ptr == '0') {
+                if (!fill) {
+                    spec->alignment = Spec::AfterSign;
+                    spec->fill = '0';
+                }
+                ++ ptr;
+            }
+
+            std::size_t size = 0;
+            const Char* next = parse_size(ptr, &size);
+            if (next != ptr) {
+                spec->width = size;
+                ptr = next;
+            }
+
+            if (*ptr == ',' || *ptr == '_') {
+                spec->thoudsandsSeperator = true;
+                spec->separator = *ptr;
+                ++ ptr;
+            }
+
+            if (*ptr == '.') {
+                ++ ptr;
+                if (!*ptr) {
+                    invalid_format_string(ptr - fmt, "expected number");
+                }
+                next = parse_size(ptr, &size);
+                if (next != ptr) {
+                    spec->precision = size;
+                    ptr = next;
+                }
+                precision = true;
+            }
+
+            Char type = *ptr;
+            switch (type) {
+            case 'a':
+            case 'A':
+                spec->type = Spec::HexFloat;
+                spec->upperCase = type == 'A';
+                ++ ptr;
+                break;
+
+            case 'b':
+            case 'B':
+                spec->type = Spec::Bin;
+                spec->upperCase = type == 'B';
+                ++ ptr;
+                break;
+
+            case 'c':
+                spec->type = Spec::Character;
+                ++ ptr;
+                break;
+
+            case 'd':
+                spec->type = Spec::Dec;
+                ++ ptr;
+                break;
+
+            case 'e':
+            case 'E':
+                spec->type = Spec::Exp;
+                spec->upperCase = type == 'E';
+                if (!precision) {
+                    spec->precision = 6;
+                }
+                ++ ptr;
+                break;
+
+            case 'f':
+            case 'F':
+                spec->type = Spec::Fixed;
+                spec->upperCase = type == 'F';
+                if (!precision) {
+                    spec->precision = 6;
+                }
+                ++ ptr;
+                break;
+
+            case 'g':
+            case 'G':
+                spec->type = Spec::General;
+                spec->upperCase = type == 'G';
+                if (!precision) {
+                    spec->precision = 6;
+                }
+                ++ ptr;
+                break;
+
+            /*
+            case 'n':
+            case 'N':
+                optionsptr->type = Spec::LocaleAwareNumber;
+                spec->upperCase = type == 'N';
+                ++ ptr;
+                break;
+            */
+
+            case 'o':
+            case 'O':
+                spec->type = Spec::Oct;
+                spec->upperCase = type == 'O';
+                ++ ptr;
+                break;
+
+            case 's':
+            case 'S':
+                spec->type = Spec::String;
+                spec->upperCase = type == 'S';
+                ++ ptr;
+                break;
+
+            case 'x':
+            case 'X':
+                spec->type = Spec::Hex;
+                spec->upperCase = type == 'X';
+                ++ ptr;
+                break;
+
+            case '%':
+                spec->type = Spec::Percentage;
+                if (!precision) {
+                    spec->precision = 6;
+                }
+                ++ ptr;
+                break;
+            }
+
+            // Anything the grammar doesn't cover (up to the end of the field) is a custom spec
+            // for a user defined formatter. The typed format checks which argument it is for.
+            if (customSpecs && *ptr && *ptr != '}') {
+                const Char* end = ptr;
+                while (*end && *end != '}') {
+                    ++ end;
+                }
+                *spec = Spec();
+                spec->type = Spec::Custom;
+                spec->custom = start;
+                spec->customLength = (std::uint32_t)(end - start);
+                return end;
+            }
+
+            if (spec->alignment == Spec::AfterSign && spec->isStringType()) {
+                invalid_format_spec("'=' alignment not allowed in string format specifier");
+            }
+
+            // like Python '_' also groups 'b', 'o' and 'x' (by four digits), ',' doesn't
+            if (spec->thoudsandsSeperator &&
+                    spec->type != Spec::Generic &&
+                    spec->type != Spec::Dec &&
+                    spec->type != Spec::Exp &&
+                    spec->type != Spec::Fixed &&
+                    spec->type != Spec::General &&
+                    spec->type != Spec::Percentage &&
+                    (spec->separator != '_' || (
+                        spec->type != Spec::Bin &&
+                        spec->type != Spec::Oct &&
+                        spec->type != Spec::Hex))) {
+                invalid_format_spec((char)spec->separator, (char)type);
+            }
+
+            if (spec->alternate && spec->isStringType()) {
+                invalid_format_spec("Alternate form (#) not allowed in string format specifier");
+            }
+
+            if (precision && (!spec->isFloatType() && spec->type != Spec::Generic)) {
+                invalid_format_spec('.', (char)type);
+            }
+
+            return ptr;
+        }
+
+        // Parses fmt and reports the result to builder, which has to provide:
+        //
+        //   append(Char ch)                        add a character to the current literal
+        //   flush()                                end the current literal (if any)
+        //   value(index, Conversion, const Spec&)  add a replacement field
+        //
+        // This is used for parsing at run time (parse_format) and at compile time (BasicStaticFormat).
+        // Custom specs are only accepted with customSpecs, i.e. for typed formats.
+        template<typename Char, typename Builder>
+        constexpr void parse_format_into(const Char* fmt, Builder& builder, bool customSpecs = false) {
+            // Format string similar to Python, but a bit more limited:
+            // https://docs.python.org/3/library/string.html#format-string-syntax
+            //
+            // And added "a" and "A" format specifier from C99 format strings and upper case variant of some more types.
+            //
+            // replacement_field ::=  "{" [arg_index] ["!" conversion] [":" format_spec] "}"
+            // arg_index         ::=  integer
+            // conversion        ::=  "r" | "s"
+            // format_spec       ::=  standard_spec | custom_spec
+            // standard_spec     ::=  [[fill]align][sign][#][0][width][,][.precision][type]
+            // custom_spec       ::=  <any characters except "}", given to a user defined formatter,
+            //                         only in typed formats>
+            // fill              ::=  <any character>
+            // align             ::=  "<" | ">" | "=" | "^"
+            // sign              ::=  "+" | "-" | " "
+            // width             ::=  integer
+            // precision         ::=  integer
+            // type              ::=  "b" | "B" | "c" | "d" | "e" | "E" | "f" | "F" | "g" | "G" | "n" | "o" | "O" | "s" | "S" | "x" | "X" | "%" | "a" | "A"
+
+            std::size_t currentIndex = 0;
+            const Char* ptr = fmt;
+
+            while (*ptr) {
+                Char ch = *ptr;
+
+                switch (ch) {
+                case '{':
+                    ++ ptr;
+                    ch = *ptr;
+                    if (ch == '{') {
+                        builder.append(ch);
+                    }
+                    else {
+                        builder.flush();
+
+                        // parse format
+                        std::size_t index = currentIndex;
+                        BasicFormatSpec<Char> spec;
+                        Conversion conv = NoConv;
+
+                        if (ch >= '0' && ch <= '9') {
+                            ptr = parse_size(ptr, &index);
+                            ch = *ptr;
+                        }
+                        else {
+                            ++ currentIndex;
+                        }
+
+                        if (index > UINT32_MAX) {
+                            invalid_format_string(ptr - fmt, "argument index too big");
+                        }
+
+                        if (ch == '!') {
+                            ++ ptr;
+                            ch = *ptr;
+                            if (ch == 'r') {
+                                conv = ReprConv;
+                            }
+                            else if (ch == 's') {
+                                conv = StrConv;
+                            }
+                            else {
+                                invalid_format_string(ptr - fmt, "expected 'r' or 's'");
+                            }
+                            ++ ptr;
+                            ch = *ptr;
+                        }
+
+                        if (ch == ':') {
+                            ++ ptr;
+                            ptr = parse_spec_internal(fmt, ptr, &spec, customSpecs);
+                            ch = *ptr;
+                        }
+
+                        if (ch != '}') {
+                            invalid_format_string(ptr - fmt, "expected '}'");
+                        }
+
+                        builder.value(index, conv, spec);
+                    }
+                    break;
+
+                case '}':
+                    ++ ptr;
+                    if (*ptr == '}') {
+                        builder.append(ch);
+                    }
+                    else {
+                        invalid_format_string(ptr - fmt, "expected '}'");
+                    }
+                    break;
+
+                default:
+                    builder.append(ch);
+                    break;
+                }
+                ++ ptr;
+            }
+
+            builder.flush();
+        }
+    }
+
+    // A format string parsed at compile time:
+    //
+    //     static constexpr BasicStaticFormat<char, 8> fmt("{:#x} {}");
+    //
+    // N is the size of the string literal including the terminating NUL, which bounds the
+    // number of items, specs and literal characters. Malformed format strings are compile
+    // errors when this is evaluated in a constant expression.
+    template<typename Char, std::size_t N>
+    class BasicStaticFormat {
+    public:
+        typedef Char char_type;
+        typedef BasicFormatItem<Char> item_type;
+        typedef BasicFormatSpec<Char> spec_type;
+
+        constexpr explicit BasicStaticFormat(const Char (&fmt)[N]) :
+                m_items(), m_specs(), m_chars(), m_size(0), m_specCount(0), m_charCount(0), m_literalStart(0) {
+            impl::parse_format_into(fmt, *this);
+        }
+
+        constexpr const item_type* items() const noexcept { return m_items; }
+        constexpr const spec_type* specs() const noexcept { return m_specs; }
+        constexpr const Char*      chars() const noexcept { return m_chars; }
+        constexpr std::size_t      size()  const noexcept { return m_size; }
+
+        // ---- builder interface used by the parser ----
+        constexpr void append(Char ch) {
+            m_chars[m_charCount ++] = ch;
+        }
+
+        constexpr void flush() {
+            if (m_charCount > m_literalStart) {
+                typename item_type::LiteralData literal = {(std::uint32_t)m_literalStart, (std::uint32_t)(m_charCount - m_literalStart)};
+                m_items[m_size ++] = item_type(literal);
+                m_literalStart = m_charCount;
+            }
+        }
+
+        constexpr void value(std::size_t index, Conversion conv, const spec_type& spec) {
+            std::size_t specIndex = 0;
+            while (specIndex < m_specCount && !m_specs[specIndex].equals(spec)) {
+                ++ specIndex;
+            }
+            if (specIndex == m_specCount) {
+                m_specs[m_specCount ++] = spec;
+            }
+            typename item_type::ValueData value = {(std::uint32_t)index, (std::uint32_t)specIndex};
+            m_items[m_size ++] = item_type(conv, value);
+        }
+
+    private:
+        item_type   m_items[N];
+        spec_type   m_specs[N];
+        Char        m_chars[N];
+        std::size_t m_size;
+        std::size_t m_specCount;
+        std::size_t m_charCount;
+        std::size_t m_literalStart;
+    };
+}
+
+#endif // FORMATSTRING_FORMATPARSER_H
@@ -34,9 +34,11 @@ namespace formatstring {
         typedef BasicFormatSpec<char_type> self_type;
 
         static const self_type DEFAULT;
-        static const int DEFAULT_PRECISION = 12;
+        // no precision given: shortest representation for '', all hex digits for 'a', 6 digits
+        // for the other float types
+        static const int DEFAULT_PRECISION = -1;
 
-        enum Alignment {
+        enum Alignment : unsigned char {
             DefaultAlignment,
             Left,
             Right,
@@ -44,7 +46,7 @@ namespace formatstring {
             AfterSign
         };
 
-        enum Type {
+        enum Type : unsigned char {
             // generic type:
             Generic,
 
@@ -62,36 +64,52 @@ namespace formatstring {
             Percentage,
             HexFloat,
 
-            String
+            String,
+
+            // a spec the standard grammar doesn't cover, for user defined formatters (see
+            // formatter in format_traits_fwd.h), only made for typed formats
+            Custom
 
             // TODO:
             // LocaleAwareNumber
         };
 
-        enum Sign {
+        enum Sign : unsigned char {
             DefaultSign,
             Always,
             NegativeOnly,
             SpaceForPositive
         };
 
+        // ordered for a compact layout, compiled formats keep a table of these
+
+        // The text of a Custom spec. It is not copied by the spec: it points into the
+        // BasicFormatItems that owns the spec. parse_spec() never makes a Custom spec.
+        const char_type* custom;
+
+        int       width;
+        int       precision;
+        std::uint32_t customLength;
         char_type fill;
+        char_type separator;
         Alignment alignment;
         Sign      sign;
+        Type      type;
         bool      alternate;
-        int       width;
         bool      thoudsandsSeperator;
-        int       precision;
-        Type      type;
         bool      upperCase;
 
+        // digits per group when thoudsandsSeperator is set, 0 means the default for the
+        // type: 4 for 'b', 'o' and 'x', 3 otherwise
+        unsigned char grouping;
+
         inline BasicFormatSpec(const char_type* spec) : BasicFormatSpec(std::move(parse_spec(spec))) {}
 
         inline BasicFormatSpec(const std::basic_string<char_type>& spec) : BasicFormatSpec(spec.c_str()) {}
 
         BasicFormatSpec(const self_type& other) = default;
 
-        inline BasicFormatSpec(
+        constexpr BasicFormatSpec(
                 char_type fill = ' ',
                 Alignment alignment = DefaultAlignment,
                 Sign      sign = DefaultSign,
@@ -100,9 +118,12 @@ namespace formatstring {
                 bool      thoudsandsSeperator = false,
                 int       precision = DEFAULT_PRECISION,
                 Type      type = Generic,
-                bool      upperCase = false) noexcept :
-            fill(fill), alignment(alignment), sign(sign), alternate(alternate), width(width),
-            thoudsandsSeperator(thoudsandsSeperator), precision(precision), type(type), upperCase(upperCase) {}
+                bool      upperCase = false,
+                char_type separator = ',',
+                unsigned char grouping = 0) noexcept :
+            custom(nullptr), width(width), precision(precision), customLength(0), fill(fill), separator(separator),
+            alignment(alignment), sign(sign), type(type), alternate(alternate), thoudsandsSeperator(thoudsandsSeperator),
+            upperCase(upperCase), grouping(grouping) {}
 
         self_type& operator= (const self_type& other) = default;
 
@@ -116,15 +137,22 @@ namespace formatstring {
             return *this;
         }
 
-        inline bool equals(const self_type& other) const noexcept {
+        constexpr bool equals(const self_type& other) const noexcept {
             return fill == other.fill && alignment == other.alignment &&
                    sign == other.sign && alternate == other.alternate &&
                    width == other.width && thoudsandsSeperator == other.thoudsandsSeperator &&
                    precision == other.precision && type == other.type &&
-                   upperCase == other.upperCase;
+                   upperCase == other.upperCase && separator == other.separator &&
+                   grouping == other.grouping && customLength == other.customLength &&
+                   equalChars(custom, other.custom, customLength);
+        }
+
+        constexpr unsigned int groupSize() const noexcept {
+            return grouping != 0 ? grouping :
+                   type == Bin || type == Oct || type == Hex ? 4 : 3;
         }
 
-        inline bool isNumberType() const noexcept {
+        constexpr bool isNumberType() const noexcept {
             switch (type) {
             case Bin:
             case Character:
@@ -143,7 +171,7 @@ namespace formatstring {
             }
         }
 
-        inline bool isIntegerType() const noexcept {
+        constexpr bool isIntegerType() const noexcept {
             switch (type) {
             case Bin:
             case Character:
@@ -157,7 +185,7 @@ namespace formatstring {
             }
         }
 
-        inline bool isFloatType() const noexcept {
+        constexpr bool isFloatType() const noexcept {
             switch (type) {
             case Exp:
             case Fixed:
@@ -171,7 +199,7 @@ namespace formatstring {
             }
         }
 
-        inline bool isStringType() const noexcept {
+        constexpr bool isStringType() const noexcept {
             switch (type) {
             case Character:
             case String:
@@ -181,15 +209,25 @@ namespace formatstring {
                 return false;
             }
         }
+
+    private:
+        static constexpr bool equalChars(const char_type* lhs, const char_type* rhs, std::uint32_t length) noexcept {
+            for (std::uint32_t index = 0; index < length; ++ index) {
+                if (lhs[index] != rhs[index]) {
+                    return false;
+                }
+            }
+            return true;
+        }
     };
 
     template<typename Char>
-    inline bool operator==(const BasicFormatSpec<Char>& lhs, const BasicFormatSpec<Char>& rhs) noexcept {
+    constexpr bool operator==(const BasicFormatSpec<Char>& lhs, const BasicFormatSpec<Char>& rhs) noexcept {
         return lhs.equals(rhs);
     }
 
     template<typename Char>
-    inline bool operator!=(const BasicFormatSpec<Char>& lhs, const BasicFormatSpec<Char>& rhs) noexcept {
+    constexpr bool operator!=(const BasicFormatSpec<Char>& lhs, const BasicFormatSpec<Char>& rhs) noexcept {
         return !lhs.equals(rhs);
     }
 
@@ -9,8 +9,9 @@
 #include "formatstring/formatspec.h"
 #include "formatstring/formatvalue.h"
 #include "formatstring/format_traits.h"
+#include "formatstring/writer.h"
 
-#include <sstream>
+#include <ostream>
 
 namespace formatstring {
 
@@ -46,14 +47,34 @@ namespace formatstring {
         BasicFormattedValue(BasicFormattedValue<Char>&& other) :
             m_formatter(std::move(other.m_formatter)), m_conv(other.m_conv), m_spec(other.m_spec) {}
 
-        inline void format(std::basic_ostream<Char>& out) const {
+        inline void format(BasicWriter<Char>& out) const {
             m_formatter(out, m_conv, m_spec);
         }
 
+        inline void format(std::basic_ostream<Char>& out) const {
+            BasicOStreamWriter<Char> writer(out);
+            m_formatter(writer, m_conv, m_spec);
+            writer.flush();
+        }
+
+        inline std::size_t formatted_size() const {
+            BasicCountingWriter<Char> out;
+            format(out);
+            return out.size();
+        }
+
+        // The size is determined first, so that the string is allocated only once.
         inline operator std::basic_string<Char> () const {
-            std::basic_ostringstream<Char> out;
+            std::basic_string<Char> str(formatted_size(), (Char)0);
+            BasicBufferWriter<Char> out(&str[0], str.size());
             format(out);
-            return out.str();
+            if (out.size() != str.size()) {
+                // a custom formatter produced a different length the second time
+                str.clear();
+                BasicStringWriter<Char> retry(str);
+                format(retry);
+            }
+            return str;
         }
 
         inline self_type& align(typename spec_type::Alignment alignment) noexcept {
@@ -177,6 +198,14 @@ namespace formatstring {
             return *this;
         }
 
+        // separator between groups of size digits, 0 is the default size of the type
+        inline self_type& grouping(Char separator, unsigned char size = 0) noexcept {
+            m_spec.thoudsandsSeperator = true;
+            m_spec.separator = separator;
+            m_spec.grouping = size;
+            return *this;
+        }
+
         inline self_type& spec(const spec_type& spec) noexcept {
             m_spec = spec;
             return *this;
@@ -2,20 +2,400 @@
 #define FORMATSTRING_FORMATTER_H
 #pragma once
 
-#include <iosfwd>
 #include <vector>
+#include <string>
+#include <new>
+#include <utility>
 #include <functional>
+#include <stdexcept>
+#include <type_traits>
 
 #include "formatstring/config.h"
 #include "formatstring/formatvalue.h"
+#include "formatstring/writer.h"
 #include "formatstring/conversion.h"
 #include "formatstring/formatspec.h"
 #include "formatstring/format_traits_fwd.h"
 
 namespace formatstring {
 
+    // Converts the value according to conv and formats the result with spec. The converted
+    // text is written directly, see format_rendered().
+    template<typename Char, typename T,
+             void _format(BasicWriter<Char>& out, T value, const BasicFormatSpec<Char>& spec) = format_value,
+             void _repr(BasicWriter<Char>& out, T value) = repr_value>
+    void format_converted(BasicWriter<Char>& out, T value, Conversion conv, const BasicFormatSpec<Char>& spec) {
+        switch (conv) {
+        case ReprConv:
+            format_rendered(out, [&value](BasicWriter<Char>& buffer) {
+                _repr(buffer, value);
+            }, spec);
+            break;
+
+        case StrConv:
+            format_rendered(out, [&value](BasicWriter<Char>& buffer) {
+                _format(buffer, value, BasicFormatSpec<Char>::DEFAULT);
+            }, spec);
+            break;
+
+        default:
+            _format(out, value, spec);
+            break;
+        }
+    }
+
+    // A formatter for one argument. Built-in types are stored by value in a tagged union,
+    // anything else callable as void(BasicWriter<Char>&, Conversion, const BasicFormatSpec<Char>&)
+    // is stored in the same inline storage if it fits (heap allocated otherwise) and called
+    // through a small vtable. Unlike std::function this never allocates for ordinary
+    // arguments, which lets format() work without any allocation.
+    template<typename Char>
+    class BasicFormatter {
+    public:
+        typedef Char char_type;
+        typedef typename std::char_traits<Char>::int_type int_type;
+
+        enum Type : unsigned char {
+            None,
+            Bool,
+            Character,
+            Int,
+            UInt,
+            LongLong,
+            ULongLong,
+#ifdef FORMATSTRING_INT128_SUPPORT
+            Int128,
+            UInt128,
+#endif
+            Float,
+            Double,
+            LongDouble,
+            String,
+            Custom
+        };
+
+    private:
+        struct StringData {
+            const Char* data;
+            std::size_t size;
+        };
+
+        union Storage {
+            bool               b;
+            int_type           ch;
+            int                i;
+            unsigned int       u;
+            long long          ll;
+            unsigned long long ull;
+#ifdef FORMATSTRING_INT128_SUPPORT
+            int128             i128;
+            uint128            u128;
+#endif
+            float              f;
+            double             d;
+            long double        ld;
+            StringData         str;
+            void*              ptr;
+            typename std::aligned_storage<2 * sizeof(void*), alignof(void*)>::type buffer;
+        };
+
+        struct VTable {
+            void (*call)(const Storage& data, BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec);
+            void (*clone)(Storage& dest, const Storage& src);
+            void (*relocate)(Storage& dest, Storage& src);
+            void (*destroy)(Storage& data);
+        };
+
+        template<typename F>
+        struct InlineOps {
+            static void call(const Storage& data, BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                (*reinterpret_cast<const F*>(&data.buffer))(out, conv, spec);
+            }
+
+            static void clone(Storage& dest, const Storage& src) {
+                new (&dest.buffer) F(*reinterpret_cast<const F*>(&src.buffer));
+            }
+
+            static void relocate(Storage& dest, Storage& src) {
+                new (&dest.buffer) F(std::move(*reinterpret_cast<F*>(&src.buffer)));
+                reinterpret_cast<F*>(&src.buffer)->~F();
+            }
+
+            static void destroy(Storage& data) {
+                reinterpret_cast<F*>(&data.buffer)->~F();
+            }
+
+            static const VTable vtable;
+        };
+
+        template<typename F>
+        struct HeapOps {
+            static void call(const Storage& data, BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+                (*static_cast<const F*>(data.ptr))(out, conv, spec);
+            }
+
+            static void clone(Storage& dest, const Storage& src) {
+                dest.ptr = new F(*static_cast<const F*>(src.ptr));
+            }
+
+            static void relocate(Storage& dest, Storage& src) {
+                dest.ptr = src.ptr;
+                src.ptr = nullptr;
+            }
+
+            static void destroy(Storage& data) {
+                delete static_cast<F*>(data.ptr);
+            }
+
+            static const VTable vtable;
+        };
+
+        template<typename F>
+        using fits_inline = std::integral_constant<bool,
+            sizeof(F) <= sizeof(Storage) &&
+            alignof(Storage) % alignof(F) == 0 &&
+            std::is_nothrow_move_constructible<F>::value>;
+
+        template<typename F>
+        using is_callable = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, BasicFormatter<Char>>::value>::type;
+
+        explicit BasicFormatter(Type type) noexcept : m_type(type), m_vtable(nullptr) {}
+
+        template<typename F>
+        inline void init(F&& func, std::true_type) {
+            typedef typename std::decay<F>::type Func;
+            new (&m_data.buffer) Func(std::forward<F>(func));
+            m_vtable = &InlineOps<Func>::vtable;
+        }
+
+        template<typename F>
+        inline void init(F&& func, std::false_type) {
+            typedef typename std::decay<F>::type Func;
+            m_data.ptr = new Func(std::forward<F>(func));
+            m_vtable = &HeapOps<Func>::vtable;
+        }
+
+    public:
+        BasicFormatter() noexcept : m_type(None), m_vtable(nullptr) {}
+
+        template<typename F, typename = is_callable<F>>
+        BasicFormatter(F&& func) : m_type(Custom), m_vtable(nullptr) {
+            init(std::forward<F>(func), fits_inline<typename std::decay<F>::type>());
+        }
+
+        BasicFormatter(const BasicFormatter<Char>& other) : m_type(other.m_type), m_vtable(other.m_vtable) {
+            if (m_type == Custom) {
+                m_vtable->clone(m_data, other.m_data);
+            }
+            else {
+                m_data = other.m_data;
+            }
+        }
+
+        BasicFormatter(BasicFormatter<Char>&& other) noexcept : m_type(other.m_type), m_vtable(other.m_vtable) {
+            if (m_type == Custom) {
+                m_vtable->relocate(m_data, other.m_data);
+                other.m_type = None;
+                other.m_vtable = nullptr;
+            }
+            else {
+                m_data = other.m_data;
+            }
+        }
+
+        ~BasicFormatter() {
+            if (m_type == Custom) {
+                m_vtable->destroy(m_data);
+            }
+        }
+
+        BasicFormatter<Char>& operator= (const BasicFormatter<Char>& other) {
+            if (this != &other) {
+                BasicFormatter<Char> copy(other);
+                *this = std::move(copy);
+            }
+            return *this;
+        }
+
+        BasicFormatter<Char>& operator= (BasicFormatter<Char>&& other) noexcept {
+            if (this != &other) {
+                this->~BasicFormatter();
+                new (this) BasicFormatter<Char>(std::move(other));
+            }
+            return *this;
+        }
+
+        static inline BasicFormatter<Char> from_bool(bool value) noexcept {
+            BasicFormatter<Char> formatter(Bool);
+            formatter.m_data.b = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_char(int_type value) noexcept {
+            BasicFormatter<Char> formatter(Character);
+            formatter.m_data.ch = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_int(int value) noexcept {
+            BasicFormatter<Char> formatter(Int);
+            formatter.m_data.i = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_int(unsigned int value) noexcept {
+            BasicFormatter<Char> formatter(UInt);
+            formatter.m_data.u = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_int(long long value) noexcept {
+            BasicFormatter<Char> formatter(LongLong);
+            formatter.m_data.ll = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_int(unsigned long long value) noexcept {
+            BasicFormatter<Char> formatter(ULongLong);
+            formatter.m_data.ull = value;
+            return formatter;
+        }
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+        static inline BasicFormatter<Char> from_int(int128 value) noexcept {
+            BasicFormatter<Char> formatter(Int128);
+            formatter.m_data.i128 = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_int(uint128 value) noexcept {
+            BasicFormatter<Char> formatter(UInt128);
+            formatter.m_data.u128 = value;
+            return formatter;
+        }
+#endif
+
+        static inline BasicFormatter<Char> from_float(float value) noexcept {
+            BasicFormatter<Char> formatter(Float);
+            formatter.m_data.f = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_float(double value) noexcept {
+            BasicFormatter<Char> formatter(Double);
+            formatter.m_data.d = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_float(long double value) noexcept {
+            BasicFormatter<Char> formatter(LongDouble);
+            formatter.m_data.ld = value;
+            return formatter;
+        }
+
+        static inline BasicFormatter<Char> from_string(const Char* value) noexcept {
+            return from_string(value, std::char_traits<Char>::length(value));
+        }
+
+        // value does not need to be null terminated
+        static inline BasicFormatter<Char> from_string(const Char* value, std::size_t size) noexcept {
+            BasicFormatter<Char> formatter(String);
+            formatter.m_data.str.data = value;
+            formatter.m_data.str.size = size;
+            return formatter;
+        }
+
+        inline Type type() const noexcept { return m_type; }
+
+        inline explicit operator bool () const noexcept { return m_type != None; }
+
+        void operator () (BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) const {
+            switch (m_type) {
+            case None:
+                throw std::bad_function_call();
+
+            case Bool:
+                format_converted<Char,bool>(out, m_data.b, conv, spec);
+                break;
+
+            case Character:
+                format_converted<Char,int_type,format_int_char<Char>,repr_int_char<Char,int_type>>(out, m_data.ch, conv, spec);
+                break;
+
+            case Int:
+                format_converted<Char,int,format_integer>(out, m_data.i, conv, spec);
+                break;
+
+            case UInt:
+                format_converted<Char,unsigned int,format_integer>(out, m_data.u, conv, spec);
+                break;
+
+            case LongLong:
+                format_converted<Char,long long,format_integer>(out, m_data.ll, conv, spec);
+                break;
+
+            case ULongLong:
+                format_converted<Char,unsigned long long,format_integer>(out, m_data.ull, conv, spec);
+                break;
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+            case Int128:
+                format_converted<Char,int128,format_integer<Char,int128,uint128>>(out, m_data.i128, conv, spec);
+                break;
+
+            case UInt128:
+                format_converted<Char,uint128,format_integer<Char,uint128,uint128>>(out, m_data.u128, conv, spec);
+                break;
+#endif
+
+            case Float:
+                format_converted<Char,float,format_float>(out, m_data.f, conv, spec);
+                break;
+
+            case Double:
+                format_converted<Char,double,format_float>(out, m_data.d, conv, spec);
+                break;
+
+            case LongDouble:
+                format_converted<Char,long double,format_float>(out, m_data.ld, conv, spec);
+                break;
+
+            case String:
+                format_converted<Char,const StringData&,format_string_data,repr_string_data>(out, m_data.str, conv, spec);
+                break;
+
+            case Custom:
+                m_vtable->call(m_data, out, conv, spec);
+                break;
+            }
+        }
+
+    private:
+        static void format_string_data(BasicWriter<Char>& out, const StringData& value, const BasicFormatSpec<Char>& spec) {
+            format_string(out, value.data, value.size, spec);
+        }
+
+        static void repr_string_data(BasicWriter<Char>& out, const StringData& value) {
+            repr_string(out, value.data, value.size);
+        }
+
+        Type          m_type;
+        const VTable* m_vtable;
+        Storage       m_data;
+    };
+
+    template<typename Char>
+    template<typename F>
+    const typename BasicFormatter<Char>::VTable BasicFormatter<Char>::InlineOps<F>::vtable = {
+        &InlineOps<F>::call, &InlineOps<F>::clone, &InlineOps<F>::relocate, &InlineOps<F>::destroy
+    };
+
     template<typename Char>
-    using BasicFormatter = std::function<void(std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec)>;
+    template<typename F>
+    const typename BasicFormatter<Char>::VTable BasicFormatter<Char>::HeapOps<F>::vtable = {
+        &HeapOps<F>::call, &HeapOps<F>::clone, &HeapOps<F>::relocate, &HeapOps<F>::destroy
+    };
 
     template<typename Char>
     using BasicFormatters = std::vector< BasicFormatter<Char> >;
@@ -37,84 +417,64 @@ namespace formatstring {
 #endif
 
     template<typename Char, typename T,
-             void _format(std::basic_ostream<Char>& out, T value, const BasicFormatSpec<Char>& spec) = format_value,
-             void _repr(std::basic_ostream<Char>& out, T value) = repr_value>
+             void _format(BasicWriter<Char>& out, T value, const BasicFormatSpec<Char>& spec) = format_value,
+             void _repr(BasicWriter<Char>& out, T value) = repr_value>
     BasicFormatter<Char> make_value_formatter(T value) {
-        return [value](std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
-            switch (conv) {
-            case ReprConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _repr(buffer, value);
-                format_value(out, buffer.str(), spec);
-                break;
-            }
-            case StrConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _format(buffer, value, BasicFormatSpec<Char>::DEFAULT);
-                format_value(out, buffer.str(), spec);
-                break;
-            }
-            default:
-                _format(out, value, spec);
-                break;
-            }
+        return [value](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            format_converted<Char,T,_format,_repr>(out, value, conv, spec);
         };
     }
 
     template<typename Char, typename T, typename Ptr = const T*,
-             void _format(std::basic_ostream<Char>& out, const T& value, const BasicFormatSpec<Char>& spec) = format_value,
-             void _repr(std::basic_ostream<Char>& out, const T& value) = repr_value>
+             void _format(BasicWriter<Char>& out, const T& value, const BasicFormatSpec<Char>& spec) = format_value,
+             void _repr(BasicWriter<Char>& out, const T& value) = repr_value>
     BasicFormatter<Char> make_ptr_formatter(Ptr ptr) {
-        return [ptr](std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
-            switch (conv) {
-            case ReprConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _repr(buffer, *ptr);
-                format_value(out, buffer.str(), spec);
-                break;
-            }
-            case StrConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _format(buffer, *ptr, BasicFormatSpec<Char>::DEFAULT);
-                format_value(out, buffer.str(), spec);
-                break;
-            }
-            default:
-                _format(out, *ptr, spec);
-                break;
-            }
+        return [ptr](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            format_converted<Char,const T&,_format,_repr>(out, *ptr, conv, spec);
         };
     }
 
+    // operator<< is the only conversion of these, so !r and !s are the same as none and
+    // operator<< is called once, even with a width.
     template<typename Char, typename T>
     inline BasicFormatter<Char> make_fallback_formatter(const T* ptr) {
-        return make_ptr_formatter<Char,T,const T*,format_value_fallback,repr_value_fallback>(ptr);
+        return [ptr](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            (void)conv;
+            format_value_fallback(out, *ptr, spec);
+        };
+    }
+
+    // For types with a formatter<T,Char> specialization. Only standard specs get here, custom
+    // specs are parsed by typed formats (see format_kernel.h).
+    template<typename Char, typename T>
+    inline BasicFormatter<Char> make_user_formatter(const T* ptr) {
+        return [ptr](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            (void)conv;
+            if (spec.type == BasicFormatSpec<Char>::Custom) {
+                throw std::invalid_argument("Custom format specs are only supported by typed formats");
+            }
+            format_user_value(out, formatter<T,Char>(), *ptr, spec);
+        };
     }
 
     template<typename Char, typename Iter, Char left = '[', Char right = ']',
-             void _format(std::basic_ostream<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left, Char right) = format_slice,
-             void _repr(std::basic_ostream<Char>& out, Iter begin, Iter end, Char left, Char right) = repr_slice>
+             void _format(BasicWriter<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char, Char) = format_slice,
+             void _repr(BasicWriter<Char>& out, Iter begin, Iter end, Char, Char) = repr_slice>
     BasicFormatter<Char> make_slice_formatter(Iter begin, Iter end) {
-        return [begin, end](std::basic_ostream<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
+        return [begin, end](BasicWriter<Char>& out, Conversion conv, const BasicFormatSpec<Char>& spec) {
             switch (conv) {
             case ReprConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _repr(buffer, begin, end, left, right);
-                format_value(out, buffer.str(), spec);
+                format_rendered(out, [begin, end](BasicWriter<Char>& buffer) {
+                    _repr(buffer, begin, end, left, right);
+                }, spec);
                 break;
-            }
+
             case StrConv:
-            {
-                std::basic_ostringstream<Char> buffer;
-                _format(buffer, begin, end, BasicFormatSpec<Char>::DEFAULT, left, right);
-                format_value(out, buffer.str(), spec);
+                format_rendered(out, [begin, end](BasicWriter<Char>& buffer) {
+                    _format(buffer, begin, end, BasicFormatSpec<Char>::DEFAULT, left, right);
+                }, spec);
                 break;
-            }
+
             default:
                 _format(out, begin, end, spec, left, right);
                 break;
@@ -15,215 +15,306 @@
 #include "formatstring/config.h"
 #include "formatstring/export.h"
 #include "formatstring/formatspec.h"
+#include "formatstring/writer.h"
+#include "formatstring/format_traits_fwd.h"
+
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+#   include <string_view>
+#endif
 
 namespace formatstring {
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, bool value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, bool value);
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-    inline void repr_value(std::basic_ostream<char16_t>& out, char16_t value);
+    inline void repr_value(BasicWriter<char16_t>& out, char16_t value);
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-    inline void repr_value(std::basic_ostream<char32_t>& out, char32_t value);
+    inline void repr_value(BasicWriter<char32_t>& out, char32_t value);
 #endif
 
-    inline void repr_value(std::wostream& out, wchar_t value);
+    inline void repr_value(WWriter& out, wchar_t value);
+
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, bool value);
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, bool value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, char      value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, short     value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, int       value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long      value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long long value);
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, char      value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, short     value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, int       value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long      value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long long value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned char      value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned short     value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned int       value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned long      value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned long long value);
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned char      value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned short     value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned int       value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned long      value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned long long value);
+#ifdef FORMATSTRING_INT128_SUPPORT
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, int128  value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, uint128 value);
+#endif
+
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, float  value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, double value);
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long double value);
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, float  value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, double value);
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long double value);
+    template<typename Char> void repr_value(BasicWriter<Char>& out, const std::basic_string<Char>& value);
+    template<typename Char> void repr_value(BasicWriter<Char>& out, const Char* value);
 
-    template<typename Char> void repr_value(std::basic_ostream<Char>& out, const std::basic_string<Char>& value);
-    template<typename Char> void repr_value(std::basic_ostream<Char>& out, const Char* value);
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    template<typename Char> void repr_value(BasicWriter<Char>& out, std::basic_string_view<Char> value);
+#endif
 
     template<typename Char, typename... Args>
-    void repr_value(std::basic_ostream<Char>& out, const std::tuple<Args...>& value);
+    void repr_value(BasicWriter<Char>& out, const std::tuple<Args...>& value);
 
     template<typename Char, typename First, typename Second>
-    void repr_value(std::basic_ostream<Char>& out, const std::pair<First,Second>& value);
+    void repr_value(BasicWriter<Char>& out, const std::pair<First,Second>& value);
 
     template<typename Char, typename Iter>
-    void repr_slice(std::basic_ostream<Char>& out, Iter begin, Iter end, Char left = '[', Char right = ']');
+    void repr_slice(BasicWriter<Char>& out, Iter begin, Iter end, Char left = '[', Char right = ']');
 
     template<typename Char, typename Iter>
-    void repr_map(std::basic_ostream<Char>& out, Iter begin, Iter end, Char left = '{', Char right = '}');
+    void repr_map(BasicWriter<Char>& out, Iter begin, Iter end, Char left = '{', Char right = '}');
 
-    template<typename Char> void format_bool(std::basic_ostream<Char>& out, bool value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_int_char(std::basic_ostream<Char>& out, typename std::char_traits<Char>::int_type value, const BasicFormatSpec<Char>& spec);
-    template<typename Char, typename CharValue> void format_char(std::basic_ostream<Char>& out, CharValue value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_bool(BasicWriter<Char>& out, bool value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_int_char(BasicWriter<Char>& out, typename std::char_traits<Char>::int_type value, const BasicFormatSpec<Char>& spec);
+    template<typename Char, typename CharValue> void format_char(BasicWriter<Char>& out, CharValue value, const BasicFormatSpec<Char>& spec);
 
     template<typename Char, typename Int, typename UInt = typename std::make_unsigned<Int>::type>
-    void format_integer(std::basic_ostream<Char>& out, Int value, const BasicFormatSpec<Char>& spec);
+    void format_integer(BasicWriter<Char>& out, Int value, const BasicFormatSpec<Char>& spec);
 
     template<typename Char, typename Float>
-    void format_float(std::basic_ostream<Char>& out, Float value, const BasicFormatSpec<Char>& spec);
+    void format_float(BasicWriter<Char>& out, Float value, const BasicFormatSpec<Char>& spec);
 
-    template<typename Char> void format_string(std::basic_ostream<Char>& out, const Char value[], const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_string(BasicWriter<Char>& out, const Char value[], const BasicFormatSpec<Char>& spec);
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, bool value, const BasicFormatSpec<Char>& spec);
+    // The first length characters of value, which may contain null characters.
+    template<typename Char> void format_string(BasicWriter<Char>& out, const Char value[], std::size_t length, const BasicFormatSpec<Char>& spec);
+
+    // Throw the std::invalid_argument that format_string()/format_float() throw for an
+    // unsupported spec. Only checks that do not depend on the value are done.
+    template<typename Char> void check_string_spec(const BasicFormatSpec<Char>& spec);
+    template<typename Char> void check_float_spec(const BasicFormatSpec<Char>& spec);
+
+    // Writes what render(out) writes, aligned by spec like a string of that length. Nothing
+    // is buffered: with a width a first render into a BasicCountingWriter measures the text.
+    template<typename Char, typename Render>
+    void format_rendered(BasicWriter<Char>& out, const Render& render, const BasicFormatSpec<Char>& spec);
+
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, bool value, const BasicFormatSpec<Char>& spec);
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-    inline void format_value(std::basic_ostream<char16_t>& out, char16_t value, const U16FormatSpec& spec);
+    inline void format_value(BasicWriter<char16_t>& out, char16_t value, const U16FormatSpec& spec);
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-    inline void format_value(std::basic_ostream<char32_t>& out, char32_t value, const U32FormatSpec& spec);
+    inline void format_value(BasicWriter<char32_t>& out, char32_t value, const U32FormatSpec& spec);
 #endif
 
-    inline void format_value(std::wostream& out, wchar_t value, const WFormatSpec& spec);
+    inline void format_value(WWriter& out, wchar_t value, const WFormatSpec& spec);
+
+    template<typename Char> void format_value(BasicWriter<Char>& out, char      value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, short     value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, int       value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, long      value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, long long value, const BasicFormatSpec<Char>& spec);
+
+    template<typename Char> void format_value(BasicWriter<Char>& out, unsigned char      value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, unsigned short     value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, unsigned int       value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, unsigned long      value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, unsigned long long value, const BasicFormatSpec<Char>& spec);
 
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, char      value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, short     value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, int       value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, long      value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, long long value, const BasicFormatSpec<Char>& spec);
+#ifdef FORMATSTRING_INT128_SUPPORT
+    template<typename Char> void format_value(BasicWriter<Char>& out, int128  value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, uint128 value, const BasicFormatSpec<Char>& spec);
+#endif
 
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, unsigned char      value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, unsigned short     value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, unsigned int       value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, unsigned long      value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, unsigned long long value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, float  value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, double value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, long double value, const BasicFormatSpec<Char>& spec);
 
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, float  value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, double value, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, long double value, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, const std::basic_string<Char>& str, const BasicFormatSpec<Char>& spec);
+    template<typename Char> void format_value(BasicWriter<Char>& out, const Char* str, const BasicFormatSpec<Char>& spec);
 
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, const std::basic_string<Char>& str, const BasicFormatSpec<Char>& spec);
-    template<typename Char> void format_value(std::basic_ostream<Char>& out, const Char* str, const BasicFormatSpec<Char>& spec);
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    template<typename Char> void format_value(BasicWriter<Char>& out, std::basic_string_view<Char> str, const BasicFormatSpec<Char>& spec);
+#endif
 
     template<typename Char, typename... Args>
-    void format_value(std::basic_ostream<Char>& out, const std::tuple<Args...>& value, const BasicFormatSpec<Char>& spec);
+    void format_value(BasicWriter<Char>& out, const std::tuple<Args...>& value, const BasicFormatSpec<Char>& spec);
 
     template<typename Char, typename First, typename Second>
-    void format_value(std::basic_ostream<Char>& out, const std::pair<First,Second>& value, const FormatSpec& spec);
+    void format_value(BasicWriter<Char>& out, const std::pair<First,Second>& value, const FormatSpec& spec);
 
     template<typename Char, typename Iter>
-    void format_slice(std::basic_ostream<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '[', Char right = ']');
+    void format_slice(BasicWriter<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '[', Char right = ']');
 
     template<typename Char, typename Iter>
-    void format_map(std::basic_ostream<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '{', Char right = '}');
+    void format_map(BasicWriter<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '{', Char right = '}');
 
     template<typename Char, typename T>
-    void format_value_fallback(std::basic_ostream<Char>& out, const T& value, const BasicFormatSpec<Char>& spec);
+    void format_value_fallback(BasicWriter<Char>& out, const T& value, const BasicFormatSpec<Char>& spec);
 
-    // ---- tempalte definitions and implementation details ------------------------------------------------------------
+    // Formats value with its user defined formatter<T,Char>. For a Custom spec userFormatter
+    // has to have parsed it already.
+    template<typename Char, typename T>
+    void format_user_value(BasicWriter<Char>& out, const formatter<T,Char>& userFormatter, const T& value, const BasicFormatSpec<Char>& spec);
 
-    template<typename Char, typename Int, typename UInt = typename std::make_unsigned<Int>::type>
-    void format_integer(std::basic_ostream<Char>& out, Int value, const BasicFormatSpec<Char>& spec);
+    // Formats count values with the same spec and a separator (null terminated) between
+    // them. Defined for the integer types formatted as numbers and the floating point
+    // types. Decimal integers and floating point numbers without a width are converted
+    // into one buffer.
+    template<typename Char, typename T>
+    void format_each(BasicWriter<Char>& out, const T* values, std::size_t count, const BasicFormatSpec<Char>& spec, const Char* separator);
 
-    template<typename Char, typename Float>
-    void format_float(std::basic_ostream<Char>& out, Float value, const BasicFormatSpec<Char>& spec);
+    // Like repr_slice()/format_slice() for contiguous numbers, using format_each().
+    template<typename Char, typename T>
+    void repr_array(BasicWriter<Char>& out, const T* begin, const T* end, Char left = '[', Char right = ']');
 
-    template<typename Char>
-    void format_string(std::basic_ostream<Char>& out, const Char value[], const BasicFormatSpec<Char>& spec);
+    template<typename Char, typename T>
+    void format_array(BasicWriter<Char>& out, const T* begin, const T* end, const BasicFormatSpec<Char>& spec, Char left = '[', Char right = ']');
+
+    namespace impl {
+        // integer types that format_each() accepts and that repr_value() formats as numbers
+        template<typename T>
+        struct is_plain_integer : public std::integral_constant<bool,
+            std::is_same<T, short>::value ||
+            std::is_same<T, int>::value ||
+            std::is_same<T, long>::value ||
+            std::is_same<T, long long>::value ||
+            std::is_same<T, unsigned short>::value ||
+            std::is_same<T, unsigned int>::value ||
+            std::is_same<T, unsigned long>::value ||
+            std::is_same<T, unsigned long long>::value> {};
+
+        // number types that format_each() accepts and that repr_value() formats as numbers
+        template<typename T>
+        struct is_plain_number : public std::integral_constant<bool,
+            is_plain_integer<T>::value || std::is_floating_point<T>::value> {};
+    }
+
+    // ---- tempalte definitions and implementation details ------------------------------------------------------------
 
     template<typename Char>
-    void repr_char(std::basic_ostream<Char>& out, Char value);
+    void repr_char(BasicWriter<Char>& out, Char value);
 
     template<typename Char, typename CharValue>
-    void repr_int_char(std::basic_ostream<Char>& out, CharValue value);
+    void repr_int_char(BasicWriter<Char>& out, CharValue value);
+
+    template<typename Char>
+    void repr_string(BasicWriter<Char>& out, const Char* value);
 
     template<typename Char>
-    void repr_string(std::basic_ostream<Char>& out, const Char* value);
+    void repr_string(BasicWriter<Char>& out, const Char* value, std::size_t length);
+
+    template<typename Char, typename Float>
+    void repr_float(BasicWriter<Char>& out, Float value);
 
     // ---- format_value impl ----
     template<typename Char, typename CharValue>
-    inline void format_char(std::basic_ostream<Char>& out, CharValue value, const BasicFormatSpec<Char>& spec) {
+    inline void format_char(BasicWriter<Char>& out, CharValue value, const BasicFormatSpec<Char>& spec) {
         format_int_char<Char>(out, value, spec);
     }
 
     template<typename Char, typename CharValue>
-    inline void repr_int_char(std::basic_ostream<Char>& out, CharValue value) { repr_char(out, (Char)value); }
+    inline void repr_int_char(BasicWriter<Char>& out, CharValue value) { repr_char(out, (Char)value); }
 
     template<typename Char>
-    inline void format_value(std::basic_ostream<Char>& out, bool value, const BasicFormatSpec<Char>& spec) { format_bool(out, value, spec); }
+    inline void format_value(BasicWriter<Char>& out, bool value, const BasicFormatSpec<Char>& spec) { format_bool(out, value, spec); }
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-    inline void format_value(std::basic_ostream<char16_t>& out, char16_t value, const U16FormatSpec& spec) { format_int_char<char16_t>(out, value, spec); }
+    inline void format_value(BasicWriter<char16_t>& out, char16_t value, const U16FormatSpec& spec) { format_int_char<char16_t>(out, value, spec); }
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-    inline void format_value(std::basic_ostream<char32_t>& out, char32_t value, const U32FormatSpec& spec) { format_int_char<char32_t>(out, value, spec); }
+    inline void format_value(BasicWriter<char32_t>& out, char32_t value, const U32FormatSpec& spec) { format_int_char<char32_t>(out, value, spec); }
 #endif
 
-    inline void format_value(std::wostream& out, wchar_t value, const WFormatSpec& spec) { format_int_char<wchar_t>(out, value, spec); }
+    inline void format_value(WWriter& out, wchar_t value, const WFormatSpec& spec) { format_int_char<wchar_t>(out, value, spec); }
+
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, Char value, const BasicFormatSpec<Char>& spec) { format_int_char<Char>(out, value, spec); }
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, Char value, const BasicFormatSpec<Char>& spec) { format_int_char<Char>(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, char      value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, short     value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, int       value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, long      value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, long long value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, char      value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, short     value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, int       value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, long      value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, long long value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, signed char        value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, unsigned char      value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, unsigned short     value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, unsigned int       value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, unsigned long      value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, unsigned long long value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+    // std::make_unsigned doesn't know __int128 in strict ISO mode
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, int128  value, const BasicFormatSpec<Char>& spec) { format_integer<Char,int128,uint128>(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, uint128 value, const BasicFormatSpec<Char>& spec) { format_integer<Char,uint128,uint128>(out, value, spec); }
+#endif
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, signed char        value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, unsigned char      value, const BasicFormatSpec<Char>& spec) { format_int_char<char>(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, unsigned short     value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, unsigned int       value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, unsigned long      value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, unsigned long long value, const BasicFormatSpec<Char>& spec) { format_integer(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, float  value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, double value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, long double value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, float  value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, double value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, long double value, const BasicFormatSpec<Char>& spec) { format_float(out, value, spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, const std::basic_string<Char>& str, const BasicFormatSpec<Char>& spec) { format_string(out, str.data(), str.size(), spec); }
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, const Char* str, const BasicFormatSpec<Char>& spec) { format_string(out, str, spec); }
 
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, const std::basic_string<Char>& str, const BasicFormatSpec<Char>& spec) { format_string(out, str.c_str(), spec); }
-    template<typename Char> inline void format_value(std::basic_ostream<Char>& out, const Char* str, const BasicFormatSpec<Char>& spec) { format_string(out, str, spec); }
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    template<typename Char> inline void format_value(BasicWriter<Char>& out, std::basic_string_view<Char> str, const BasicFormatSpec<Char>& spec) { format_string(out, str.data(), str.size(), spec); }
+#endif
 
     // --- repr_value impl ----
-    template<typename Char> void repr_bool(std::basic_ostream<Char>& out, bool value);
+    template<typename Char> void repr_bool(BasicWriter<Char>& out, bool value);
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, bool value) { repr_bool(out, value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, bool value) { repr_bool(out, value); }
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-    inline void repr_value(std::basic_ostream<char16_t>& out, char16_t value) { repr_char(out, value); }
+    inline void repr_value(BasicWriter<char16_t>& out, char16_t value) { repr_char(out, value); }
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-    inline void repr_value(std::basic_ostream<char32_t>& out, char32_t value) { repr_char(out, value); }
+    inline void repr_value(BasicWriter<char32_t>& out, char32_t value) { repr_char(out, value); }
 #endif
 
-    inline void repr_value(std::wostream& out, wchar_t value) { repr_char(out, value); }
+    inline void repr_value(WWriter& out, wchar_t value) { repr_char(out, value); }
+
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, char      value) { repr_char(out, (Char)value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, short     value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, int       value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long      value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long long value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, signed char        value) { repr_char(out, (Char)value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned char      value) { repr_char(out, (Char)value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned short     value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned int       value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned long      value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, unsigned long long value) { format_integer(out, value, BasicFormatSpec<Char>::DEFAULT); }
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, char      value) { repr_char(out, (Char)value); }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, short     value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, int       value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long      value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long long value) { out << value; }
+#ifdef FORMATSTRING_INT128_SUPPORT
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, int128  value) { format_integer<Char,int128,uint128>(out, value, BasicFormatSpec<Char>::DEFAULT); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, uint128 value) { format_integer<Char,uint128,uint128>(out, value, BasicFormatSpec<Char>::DEFAULT); }
+#endif
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, signed char        value) { repr_char(out, (Char)value); }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned char      value) { repr_char(out, (Char)value); }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned short     value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned int       value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned long      value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, unsigned long long value) { out << value; }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, float  value) { repr_float(out, value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, double value) { repr_float(out, value); }
+    template<typename Char> inline void repr_value(BasicWriter<Char>& out, long double value) { repr_float(out, value); }
 
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, float  value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, double value) { out << value; }
-    template<typename Char> inline void repr_value(std::basic_ostream<Char>& out, long double value) { out << value; }
+    template<typename Char> void repr_value(BasicWriter<Char>& out, const std::basic_string<Char>& value) { repr_string(out, value.data(), value.size()); }
+    template<typename Char> void repr_value(BasicWriter<Char>& out, const Char* value) { repr_string(out, value); }
 
-    template<typename Char> void repr_value(std::basic_ostream<Char>& out, const std::basic_string<Char>& value) { repr_string(out, value.c_str()); }
-    template<typename Char> void repr_value(std::basic_ostream<Char>& out, const Char* value) { repr_string(out, value); }
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    template<typename Char> void repr_value(BasicWriter<Char>& out, std::basic_string_view<Char> value) { repr_string(out, value.data(), value.size()); }
+#endif
 
     namespace impl {
         template<typename Char, std::size_t N, typename... Args>
         struct format_tail {
-            static inline void format(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+            static inline void format(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
                 format_tail<Char,N-1,Args...>::format(out, value);
                 out.put(',');
                 out.put(' ');
@@ -233,7 +324,7 @@ namespace formatstring {
 
         template<typename Char, typename... Args>
         struct format_tail<Char, 0, Args...> {
-            static inline void format(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+            static inline void format(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
                 (void)out;
                 (void)value;
             }
@@ -241,21 +332,21 @@ namespace formatstring {
 
         template<typename Char, typename... Args>
         struct format_tail<Char, 1, Args...> {
-            static inline void format(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+            static inline void format(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
                 repr_value(out, std::get<0>(value));
             }
         };
 
         template<typename Char, std::size_t N, typename... Args>
         struct format_tuple {
-            static inline void format(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+            static inline void format(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
                 format_tail< Char, std::tuple_size< std::tuple<Args...> >::value, Args...>::format(out, value);
             }
         };
 
         template<typename Char, typename... Args>
         struct format_tuple<Char, 1, Args...> {
-            static inline void format(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+            static inline void format(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
                 repr_value(out, std::get<0>(value));
                 out.put(',');
             }
@@ -264,60 +355,164 @@ namespace formatstring {
 
     // --- format_value for complex types ----
 
-    template<typename Char, typename... Args>
-    void format_value(std::basic_ostream<Char>& out, const std::tuple<Args...>& value, const BasicFormatSpec<Char>& spec) {
-        std::basic_ostringstream<Char> buffer;
+    template<typename Char, typename Render>
+    void format_rendered(BasicWriter<Char>& out, const Render& render, const BasicFormatSpec<Char>& spec) {
+        typedef BasicFormatSpec<Char> Spec;
+
+        check_string_spec(spec);
+
+        std::size_t padding = 0;
+        if (spec.width > 0) {
+            BasicCountingWriter<Char> counter;
+            render(counter);
+            if (counter.size() < (std::size_t)spec.width) {
+                padding = spec.width - counter.size();
+            }
+        }
+
+        if (padding == 0) {
+            render(out);
+            return;
+        }
+
+        std::size_t before = 0;
+        switch (spec.alignment) {
+        case Spec::AfterSign:
+            throw std::invalid_argument("'=' alignment not allowed in string or character format specifier");
+
+        case Spec::Left:
+        case Spec::DefaultAlignment:
+            break;
 
-        repr_value(buffer, value);
+        case Spec::Right:
+            before = padding;
+            break;
 
-        format_value(out, buffer.str(), spec);
+        case Spec::Center:
+            before = padding / 2;
+            break;
+        }
+
+        out.fill(spec.fill, before);
+        render(out);
+        out.fill(spec.fill, padding - before);
+    }
+
+    template<typename Char, typename... Args>
+    void format_value(BasicWriter<Char>& out, const std::tuple<Args...>& value, const BasicFormatSpec<Char>& spec) {
+        format_rendered(out, [&value](BasicWriter<Char>& buffer) {
+            repr_value(buffer, value);
+        }, spec);
     }
 
     template<typename Char, typename First, typename Second>
-    void format_value(std::basic_ostream<Char>& out, const std::pair<First,Second>& value, const FormatSpec& spec) {
-        std::basic_ostringstream<Char> buffer;
+    void format_value(BasicWriter<Char>& out, const std::pair<First,Second>& value, const FormatSpec& spec) {
+        format_rendered(out, [&value](BasicWriter<Char>& buffer) {
+            repr_value(buffer, value);
+        }, spec);
+    }
 
-        repr_value(buffer, value);
+    template<typename Char, typename Iter>
+    void format_slice(BasicWriter<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left, Char right) {
+        format_rendered(out, [&](BasicWriter<Char>& buffer) {
+            repr_slice(buffer, begin, end, left, right);
+        }, spec);
+    }
 
-        format_value(out, buffer.str(), spec);
+    template<typename Char, typename T>
+    void format_array(BasicWriter<Char>& out, const T* begin, const T* end, const BasicFormatSpec<Char>& spec, Char left, Char right) {
+        format_rendered(out, [&](BasicWriter<Char>& buffer) {
+            repr_array(buffer, begin, end, left, right);
+        }, spec);
     }
 
     template<typename Char, typename Iter>
-    void format_slice(std::basic_ostream<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '[', Char right = ']') {
-        std::basic_ostringstream<Char> buffer;
+    void format_map(BasicWriter<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left, Char right) {
+        format_rendered(out, [&](BasicWriter<Char>& buffer) {
+            repr_map(buffer, begin, end, left, right);
+        }, spec);
+    }
 
-        repr_slice(buffer, begin, end, left, right);
+    namespace impl {
+        // A string kept per thread for format_value_fallback(). It is taken out of the pool
+        // while in use, so an operator<< that formats a fallback value itself gets a new one.
+        template<typename Char>
+        class scratch_string {
+        public:
+            // larger strings are not kept
+            static const std::size_t MAX_POOLED = 4096;
+
+            scratch_string() {
+                m_str.swap(pool());
+                m_str.clear();
+            }
 
-        format_value(out, buffer.str(), spec);
-    }
+            ~scratch_string() {
+                if (m_str.capacity() <= MAX_POOLED) {
+                    m_str.swap(pool());
+                }
+            }
 
-    template<typename Char, typename Iter>
-    void format_map(std::basic_ostream<Char>& out, Iter begin, Iter end, const BasicFormatSpec<Char>& spec, Char left = '{', Char right = '}') {
-        std::basic_ostringstream<Char> buffer;
+            inline std::basic_string<Char>& str() { return m_str; }
+
+        private:
+            static std::basic_string<Char>& pool() {
+                static thread_local std::basic_string<Char> str;
+                return str;
+            }
+
+            std::basic_string<Char> m_str;
+        };
 
-        repr_map(buffer, begin, end, left, right);
+        template<typename Char, typename T>
+        inline void stream_value(BasicWriter<Char>& out, const T& value) {
+            BasicWriterStreamBuf<Char> buffer(out);
+            std::basic_ostream<Char> stream(&buffer);
+            stream << value;
+        }
+    }
 
-        format_value(out, buffer.str(), spec);
+    // Without a width operator<< writes straight to out. With a width its output has to be
+    // measured before the padding, it is collected in a per thread scratch string.
+    template<typename Char, typename T>
+    void format_value_fallback(BasicWriter<Char>& out, const T& value, const BasicFormatSpec<Char>& spec) {
+        check_string_spec(spec);
+        if (spec.width <= 0) {
+            impl::stream_value(out, value);
+        }
+        else {
+            impl::scratch_string<Char> scratch;
+            {
+                BasicStringWriter<Char> buffer(scratch.str());
+                impl::stream_value(buffer, value);
+            }
+            format_string(out, scratch.str().data(), scratch.str().size(), spec);
+        }
     }
 
     template<typename Char, typename T>
-    void format_value_fallback(std::basic_ostream<Char>& out, const T& value, const BasicFormatSpec<Char>& spec) {
-        std::basic_ostringstream<Char> buffer;
-        buffer << value;
-        format_value(out, buffer.str(), spec);
+    void format_user_value(BasicWriter<Char>& out, const formatter<T,Char>& userFormatter, const T& value, const BasicFormatSpec<Char>& spec) {
+        if (spec.type == BasicFormatSpec<Char>::Custom) {
+            userFormatter.format(out, value);
+        }
+        else {
+            format_rendered(out, [&userFormatter, &value](BasicWriter<Char>& buffer) {
+                userFormatter.format(buffer, value);
+            }, spec);
+        }
     }
 
     // --- repr_value for complex types ----
 
     template<typename Char, typename... Args>
-    void repr_value(std::basic_ostream<Char>& out, const std::tuple<Args...>& value) {
+    void repr_value(BasicWriter<Char>& out, const std::tuple<Args...>& value) {
         out.put('(');
         impl::format_tuple<Char,std::tuple_size< std::tuple<Args...> >::value, Args...>::format(out, value);
         out.put(')');
     }
 
     template<typename Char, typename First, typename Second>
-    void repr_value(std::basic_ostream<Char>& out, const std::pair<First,Second>& value) {
+    void repr_value(BasicWriter<Char>& out, const std::pair<First,Second>& value) {
         out.put('(');
         repr_value(out, value.first);
         out.put(',');
@@ -327,7 +522,7 @@ namespace formatstring {
     }
 
     template<typename Char, typename Iter>
-    void repr_slice(std::basic_ostream<Char>& out, Iter begin, Iter end, Char left = '[', Char right = ']') {
+    void repr_slice(BasicWriter<Char>& out, Iter begin, Iter end, Char left, Char right) {
         out.put(left);
         if (begin != end) {
             repr_value(out, *begin);
@@ -341,8 +536,16 @@ namespace formatstring {
         out.put(right);
     }
 
+    template<typename Char, typename T>
+    void repr_array(BasicWriter<Char>& out, const T* begin, const T* end, Char left, Char right) {
+        static const Char separator[] = {',', ' ', 0};
+        out.put(left);
+        format_each(out, begin, end - begin, BasicFormatSpec<Char>::DEFAULT, separator);
+        out.put(right);
+    }
+
     template<typename Char, typename K, typename V>
-    void repr_map_item(std::basic_ostream<Char>& out, const std::pair<K,V>& item) {
+    void repr_map_item(BasicWriter<Char>& out, const std::pair<K,V>& item) {
         repr_value(out, item.first);
         out.put(':');
         out.put(' ');
@@ -350,7 +553,7 @@ namespace formatstring {
     }
 
     template<typename Char, typename Iter>
-    void repr_map(std::basic_ostream<Char>& out, Iter begin, Iter end, Char left = '{', Char right = '}') {
+    void repr_map(BasicWriter<Char>& out, Iter begin, Iter end, Char left, Char right) {
         out.put(left);
         if (begin != end) {
             repr_map_item(out, *begin);
@@ -365,124 +568,225 @@ namespace formatstring {
     }
 
     template<typename Char, typename T>
-    void repr_value_fallback(std::basic_ostream<Char>& out, const T& value) {
-        out << value;
+    void repr_value_fallback(BasicWriter<Char>& out, const T& value) {
+        impl::stream_value(out, value);
     }
 
     // ---- extern template instantiations ----
-    extern template FORMATSTRING_EXPORT void repr_bool<char>(std::ostream& out, bool value);
-    extern template FORMATSTRING_EXPORT void repr_bool<wchar_t>(std::wostream& out, bool value);
+    extern template FORMATSTRING_EXPORT void repr_bool<char>(Writer& out, bool value);
+    extern template FORMATSTRING_EXPORT void repr_bool<wchar_t>(WWriter& out, bool value);
 
-    extern template FORMATSTRING_EXPORT void repr_char<char>(std::ostream& out, char value);
-    extern template FORMATSTRING_EXPORT void repr_char<wchar_t>(std::wostream& out, wchar_t value);
+    extern template FORMATSTRING_EXPORT void repr_char<char>(Writer& out, char value);
+    extern template FORMATSTRING_EXPORT void repr_char<wchar_t>(WWriter& out, wchar_t value);
 
-    extern template FORMATSTRING_EXPORT void repr_string<char>(std::ostream& out, const char* value);
-    extern template FORMATSTRING_EXPORT void repr_string<wchar_t>(std::wostream& out, const wchar_t* value);
+    extern template FORMATSTRING_EXPORT void repr_string<char>(Writer& out, const char* value);
+    extern template FORMATSTRING_EXPORT void repr_string<char>(Writer& out, const char* value, std::size_t length);
+    extern template FORMATSTRING_EXPORT void repr_string<wchar_t>(WWriter& out, const wchar_t* value);
+    extern template FORMATSTRING_EXPORT void repr_string<wchar_t>(WWriter& out, const wchar_t* value, std::size_t length);
 
-    extern template FORMATSTRING_EXPORT void format_bool<char>(std::ostream& out, bool value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_bool<wchar_t>(std::wostream& out, bool value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_bool<char>(Writer& out, bool value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_bool<wchar_t>(WWriter& out, bool value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_int_char<char>(std::ostream& out, std::char_traits<char>::int_type value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_int_char<wchar_t>(std::wostream& out, std::char_traits<wchar_t>::int_type value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_int_char<char>(Writer& out, std::char_traits<char>::int_type value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_int_char<wchar_t>(WWriter& out, std::char_traits<wchar_t>::int_type value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_string<char>(std::ostream& out, const char value[], const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_string<wchar_t>(std::wostream& out, const wchar_t value[], const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char>(Writer& out, const char value[], const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char>(Writer& out, const char value[], std::size_t length, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<wchar_t>(WWriter& out, const wchar_t value[], const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<wchar_t>(WWriter& out, const wchar_t value[], std::size_t length, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_float<char,float>(std::ostream& out, float value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<wchar_t,float>(std::wostream& out, float value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_string_spec<char>(const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_string_spec<wchar_t>(const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_float<char,double>(std::ostream& out, double value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<wchar_t,double>(std::wostream& out, double value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_float_spec<char>(const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_float_spec<wchar_t>(const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_float<char,long double>(std::ostream& out, long double value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<wchar_t,long double>(std::wostream& out, long double value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void repr_float<char,float>(Writer& out, float value);
+    extern template FORMATSTRING_EXPORT void repr_float<wchar_t,float>(WWriter& out, float value);
 
-    extern template FORMATSTRING_EXPORT void format_integer<char,char>(std::ostream& out, char value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,short>(std::ostream& out, short value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,int>(std::ostream& out, int value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,long>(std::ostream& out, long value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,long long>(std::ostream& out, long long value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void repr_float<char,double>(Writer& out, double value);
+    extern template FORMATSTRING_EXPORT void repr_float<wchar_t,double>(WWriter& out, double value);
 
-    extern template FORMATSTRING_EXPORT void format_integer<char,signed char>(std::ostream& out, signed char value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned char>(std::ostream& out, unsigned char value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned short>(std::ostream& out, unsigned short value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned int>(std::ostream& out, unsigned int value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned long>(std::ostream& out, unsigned long value, const FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned long long>(std::ostream& out, unsigned long long value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void repr_float<char,long double>(Writer& out, long double value);
+    extern template FORMATSTRING_EXPORT void repr_float<wchar_t,long double>(WWriter& out, long double value);
 
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,wchar_t>(std::wostream& out, wchar_t value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char,float>(Writer& out, float value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<wchar_t,float>(WWriter& out, float value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,char>(std::wostream& out, char value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,short>(std::wostream& out, short value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,int>(std::wostream& out, int value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,long>(std::wostream& out, long value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,long long>(std::wostream& out, long long value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char,double>(Writer& out, double value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<wchar_t,double>(WWriter& out, double value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,signed char>(std::wostream& out, signed char value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned char>(std::wostream& out, unsigned char value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned short>(std::wostream& out, unsigned short value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned int>(std::wostream& out, unsigned int value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned long>(std::wostream& out, unsigned long value, const WFormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned long long>(std::wostream& out, unsigned long long value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char,long double>(Writer& out, long double value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<wchar_t,long double>(WWriter& out, long double value, const WFormatSpec& spec);
 
-#ifdef FORMATSTRING_CHAR16_SUPPORT
-    extern template FORMATSTRING_EXPORT void repr_bool<char16_t>(std::basic_ostream<char16_t>& out, bool value);
-    extern template FORMATSTRING_EXPORT void repr_char<char16_t>(std::basic_ostream<char16_t>& out, char16_t value);
-    extern template FORMATSTRING_EXPORT void repr_string<char16_t>(std::basic_stream<char16_t>& out, const char16_t* value);
+    extern template FORMATSTRING_EXPORT void format_integer<char,char>(Writer& out, char value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,short>(Writer& out, short value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,int>(Writer& out, int value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,long>(Writer& out, long value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,long long>(Writer& out, long long value, const FormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_bool<char16_t>(std::basic_stream<char16_t>& out, bool value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,signed char>(Writer& out, signed char value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned char>(Writer& out, unsigned char value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned short>(Writer& out, unsigned short value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned int>(Writer& out, unsigned int value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned long>(Writer& out, unsigned long value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,unsigned long long>(Writer& out, unsigned long long value, const FormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_int_char<char16_t>(std::basic_ostream<char16_t>& out, std::char_traits<char16_t>::int_type value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_string<char16_t>(std::basic_ostream<char16_t>& out, const char16_t value[], const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,wchar_t>(WWriter& out, wchar_t value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_float<char16_t,float>(std::basic_ostream<char16_t>& out, float value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<char16_t,double>(std::basic_ostream<char16_t>& out, double value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<char16_t,long double>(std::basic_ostream<char16_t>& out, long double value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,char>(WWriter& out, char value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,short>(WWriter& out, short value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,int>(WWriter& out, int value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,long>(WWriter& out, long value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,long long>(WWriter& out, long long value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,char16_t>(std::basic_ostream<char16_t>& out, char16_t value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,signed char>(WWriter& out, signed char value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned char>(WWriter& out, unsigned char value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned short>(WWriter& out, unsigned short value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned int>(WWriter& out, unsigned int value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned long>(WWriter& out, unsigned long value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,unsigned long long>(WWriter& out, unsigned long long value, const WFormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,char>(std::basic_ostream<char16_t>& out, char value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,short>(std::basic_ostream<char16_t>& out, short value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,int>(std::basic_ostream<char16_t>& out, int value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,long>(std::basic_ostream<char16_t>& out, long value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,long long>(std::basic_ostream<char16_t>& out, long long value, const U16FormatSpec& spec);
+#ifdef FORMATSTRING_INT128_SUPPORT
+    extern template FORMATSTRING_EXPORT void format_integer<char,int128,uint128>(Writer& out, int128 value, const FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char,uint128,uint128>(Writer& out, uint128 value, const FormatSpec& spec);
 
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,signed char>(std::basic_ostream<char16_t>& out, signed char value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned char>(std::basic_ostream<char16_t>& out, unsigned char value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned short>(std::basic_ostream<char16_t>& out, unsigned short value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned int>(std::basic_ostream<char16_t>& out, unsigned int value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned long>(std::basic_ostream<char16_t>& out, unsigned long value, const U16FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned long long>(std::basic_ostream<char16_t>& out, unsigned long long value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,int128,uint128>(WWriter& out, int128 value, const WFormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<wchar_t,uint128,uint128>(WWriter& out, uint128 value, const WFormatSpec& spec);
 #endif
 
-#ifdef FORMATSTRING_CHAR32_SUPPORT
-    extern template FORMATSTRING_EXPORT void repr_bool<char32_t>(std::basic_ostream<char32_t>& out, bool value);
-    extern template FORMATSTRING_EXPORT void repr_char<char32_t>(std::basic_ostream<char32_t>& out, char32_t value);
-    extern template FORMATSTRING_EXPORT void repr_string<char32_t>(std::basic_stream<char32_t>& out, const char32_t* value);
-
-    extern template FORMATSTRING_EXPORT void format_bool<char32_t>(std::basic_stream<char32_t>& out, bool value, const U32FormatSpec& spec);
-
-    extern template FORMATSTRING_EXPORT void format_int_char<char32_t>(std::basic_ostream<char32_t>& out, std::char_traits<char32_t>::int_type value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_string<char32_t>(std::basic_ostream<char32_t>& out, const char32_t value[], const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_each<char,short>(Writer& out, const short* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,int>(Writer& out, const int* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,long>(Writer& out, const long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,long long>(Writer& out, const long long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,unsigned short>(Writer& out, const unsigned short* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,unsigned int>(Writer& out, const unsigned int* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,unsigned long>(Writer& out, const unsigned long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,unsigned long long>(Writer& out, const unsigned long long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,float>(Writer& out, const float* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,double>(Writer& out, const double* values, std::size_t count, const FormatSpec& spec, const char* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char,long double>(Writer& out, const long double* values, std::size_t count, const FormatSpec& spec, const char* separator);
+
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,short>(WWriter& out, const short* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,int>(WWriter& out, const int* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,long>(WWriter& out, const long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,long long>(WWriter& out, const long long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,unsigned short>(WWriter& out, const unsigned short* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,unsigned int>(WWriter& out, const unsigned int* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,unsigned long>(WWriter& out, const unsigned long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,unsigned long long>(WWriter& out, const unsigned long long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,float>(WWriter& out, const float* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,double>(WWriter& out, const double* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<wchar_t,long double>(WWriter& out, const long double* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
 
-    extern template FORMATSTRING_EXPORT void format_float<char32_t,float>(std::basic_ostream<char32_t>& out, float value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<char32_t,double>(std::basic_ostream<char32_t>& out, double value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_float<char32_t,long double>(std::basic_ostream<char32_t>& out, long double value, const U32FormatSpec& spec);
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    extern template FORMATSTRING_EXPORT void repr_bool<char16_t>(BasicWriter<char16_t>& out, bool value);
+    extern template FORMATSTRING_EXPORT void repr_char<char16_t>(BasicWriter<char16_t>& out, char16_t value);
+    extern template FORMATSTRING_EXPORT void repr_string<char16_t>(BasicWriter<char16_t>& out, const char16_t* value);
+    extern template FORMATSTRING_EXPORT void repr_string<char16_t>(BasicWriter<char16_t>& out, const char16_t* value, std::size_t length);
+
+    extern template FORMATSTRING_EXPORT void format_bool<char16_t>(BasicWriter<char16_t>& out, bool value, const U16FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_int_char<char16_t>(BasicWriter<char16_t>& out, std::char_traits<char16_t>::int_type value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char16_t>(BasicWriter<char16_t>& out, const char16_t value[], const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char16_t>(BasicWriter<char16_t>& out, const char16_t value[], std::size_t length, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_string_spec<char16_t>(const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_float_spec<char16_t>(const U16FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void repr_float<char16_t,float>(BasicWriter<char16_t>& out, float value);
+    extern template FORMATSTRING_EXPORT void repr_float<char16_t,double>(BasicWriter<char16_t>& out, double value);
+    extern template FORMATSTRING_EXPORT void repr_float<char16_t,long double>(BasicWriter<char16_t>& out, long double value);
+
+    extern template FORMATSTRING_EXPORT void format_float<char16_t,float>(BasicWriter<char16_t>& out, float value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char16_t,double>(BasicWriter<char16_t>& out, double value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char16_t,long double>(BasicWriter<char16_t>& out, long double value, const U16FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,char16_t>(BasicWriter<char16_t>& out, char16_t value, const U16FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,char>(BasicWriter<char16_t>& out, char value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,short>(BasicWriter<char16_t>& out, short value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,int>(BasicWriter<char16_t>& out, int value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,long>(BasicWriter<char16_t>& out, long value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,long long>(BasicWriter<char16_t>& out, long long value, const U16FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,signed char>(BasicWriter<char16_t>& out, signed char value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned char>(BasicWriter<char16_t>& out, unsigned char value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned short>(BasicWriter<char16_t>& out, unsigned short value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned int>(BasicWriter<char16_t>& out, unsigned int value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned long>(BasicWriter<char16_t>& out, unsigned long value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,unsigned long long>(BasicWriter<char16_t>& out, unsigned long long value, const U16FormatSpec& spec);
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,int128,uint128>(BasicWriter<char16_t>& out, int128 value, const U16FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char16_t,uint128,uint128>(BasicWriter<char16_t>& out, uint128 value, const U16FormatSpec& spec);
+#endif
 
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,char32_t>(std::basic_ostream<char32_t>& out, char32_t value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,short>(BasicWriter<char16_t>& out, const short* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,int>(BasicWriter<char16_t>& out, const int* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,long>(BasicWriter<char16_t>& out, const long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,long long>(BasicWriter<char16_t>& out, const long long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,unsigned short>(BasicWriter<char16_t>& out, const unsigned short* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,unsigned int>(BasicWriter<char16_t>& out, const unsigned int* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,unsigned long>(BasicWriter<char16_t>& out, const unsigned long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,unsigned long long>(BasicWriter<char16_t>& out, const unsigned long long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,float>(BasicWriter<char16_t>& out, const float* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,double>(BasicWriter<char16_t>& out, const double* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char16_t,long double>(BasicWriter<char16_t>& out, const long double* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+#endif
 
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,char>(std::basic_ostream<char16_t>& out, char value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,short>(std::basic_ostream<char32_t>& out, short value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,int>(std::basic_ostream<char32_t>& out, int value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,long>(std::basic_ostream<char32_t>& out, long value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,long long>(std::basic_ostream<char32_t>& out, long long value, const U32FormatSpec& spec);
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    extern template FORMATSTRING_EXPORT void repr_bool<char32_t>(BasicWriter<char32_t>& out, bool value);
+    extern template FORMATSTRING_EXPORT void repr_char<char32_t>(BasicWriter<char32_t>& out, char32_t value);
+    extern template FORMATSTRING_EXPORT void repr_string<char32_t>(BasicWriter<char32_t>& out, const char32_t* value);
+    extern template FORMATSTRING_EXPORT void repr_string<char32_t>(BasicWriter<char32_t>& out, const char32_t* value, std::size_t length);
+
+    extern template FORMATSTRING_EXPORT void format_bool<char32_t>(BasicWriter<char32_t>& out, bool value, const U32FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_int_char<char32_t>(BasicWriter<char32_t>& out, std::char_traits<char32_t>::int_type value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char32_t>(BasicWriter<char32_t>& out, const char32_t value[], const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_string<char32_t>(BasicWriter<char32_t>& out, const char32_t value[], std::size_t length, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_string_spec<char32_t>(const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void check_float_spec<char32_t>(const U32FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void repr_float<char32_t,float>(BasicWriter<char32_t>& out, float value);
+    extern template FORMATSTRING_EXPORT void repr_float<char32_t,double>(BasicWriter<char32_t>& out, double value);
+    extern template FORMATSTRING_EXPORT void repr_float<char32_t,long double>(BasicWriter<char32_t>& out, long double value);
+
+    extern template FORMATSTRING_EXPORT void format_float<char32_t,float>(BasicWriter<char32_t>& out, float value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char32_t,double>(BasicWriter<char32_t>& out, double value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_float<char32_t,long double>(BasicWriter<char32_t>& out, long double value, const U32FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,char32_t>(BasicWriter<char32_t>& out, char32_t value, const U32FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,char>(BasicWriter<char32_t>& out, char value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,short>(BasicWriter<char32_t>& out, short value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,int>(BasicWriter<char32_t>& out, int value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,long>(BasicWriter<char32_t>& out, long value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,long long>(BasicWriter<char32_t>& out, long long value, const U32FormatSpec& spec);
+
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,signed char>(BasicWriter<char32_t>& out, signed char value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned char>(BasicWriter<char32_t>& out, unsigned char value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned short>(BasicWriter<char32_t>& out, unsigned short value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned int>(BasicWriter<char32_t>& out, unsigned int value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned long>(BasicWriter<char32_t>& out, unsigned long value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned long long>(BasicWriter<char32_t>& out, unsigned long long value, const U32FormatSpec& spec);
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,int128,uint128>(BasicWriter<char32_t>& out, int128 value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_integer<char32_t,uint128,uint128>(BasicWriter<char32_t>& out, uint128 value, const U32FormatSpec& spec);
+#endif
 
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,signed char>(std::basic_ostream<char32_t>& out, signed char value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned char>(std::basic_ostream<char32_t>& out, unsigned char value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned short>(std::basic_ostream<char32_t>& out, unsigned short value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned int>(std::basic_ostream<char32_t>& out, unsigned int value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned long>(std::basic_ostream<char32_t>& out, unsigned long value, const U32FormatSpec& spec);
-    extern template FORMATSTRING_EXPORT void format_integer<char32_t,unsigned long long>(std::basic_ostream<char32_t>& out, unsigned long long value, const U32FormatSpec& spec);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,short>(BasicWriter<char32_t>& out, const short* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,int>(BasicWriter<char32_t>& out, const int* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,long>(BasicWriter<char32_t>& out, const long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,long long>(BasicWriter<char32_t>& out, const long long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,unsigned short>(BasicWriter<char32_t>& out, const unsigned short* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,unsigned int>(BasicWriter<char32_t>& out, const unsigned int* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,unsigned long>(BasicWriter<char32_t>& out, const unsigned long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,unsigned long long>(BasicWriter<char32_t>& out, const unsigned long long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,float>(BasicWriter<char32_t>& out, const float* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,double>(BasicWriter<char32_t>& out, const double* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+    extern template FORMATSTRING_EXPORT void format_each<char32_t,long double>(BasicWriter<char32_t>& out, const long double* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
 #endif
 }
 
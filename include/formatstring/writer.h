@@ -0,0 +1,432 @@
+#ifndef FORMATSTRING_WRITER_H
+#define FORMATSTRING_WRITER_H
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <algorithm>
+#include <cstddef>
+
+#include "formatstring/config.h"
+#include "formatstring/export.h"
+
+namespace formatstring {
+
+    template<typename Char>
+    class BasicWriter;
+
+    template<typename Char>
+    class BasicOStreamWriter;
+
+    template<typename Char>
+    class BasicBufferWriter;
+
+    template<typename Char>
+    class BasicPointerWriter;
+
+    template<typename Char>
+    class BasicStringWriter;
+
+    template<typename Char>
+    class BasicCountingWriter;
+
+    template<typename Char>
+    class BasicWriterStreamBuf;
+
+    typedef BasicWriter<char>         Writer;
+    typedef BasicOStreamWriter<char>  OStreamWriter;
+    typedef BasicBufferWriter<char>   BufferWriter;
+    typedef BasicPointerWriter<char>  PointerWriter;
+    typedef BasicStringWriter<char>   StringWriter;
+    typedef BasicCountingWriter<char> CountingWriter;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    typedef BasicWriter<char16_t>         U16Writer;
+    typedef BasicOStreamWriter<char16_t>  U16OStreamWriter;
+    typedef BasicBufferWriter<char16_t>   U16BufferWriter;
+    typedef BasicPointerWriter<char16_t>  U16PointerWriter;
+    typedef BasicStringWriter<char16_t>   U16StringWriter;
+    typedef BasicCountingWriter<char16_t> U16CountingWriter;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    typedef BasicWriter<char32_t>         U32Writer;
+    typedef BasicOStreamWriter<char32_t>  U32OStreamWriter;
+    typedef BasicBufferWriter<char32_t>   U32BufferWriter;
+    typedef BasicPointerWriter<char32_t>  U32PointerWriter;
+    typedef BasicStringWriter<char32_t>   U32StringWriter;
+    typedef BasicCountingWriter<char32_t> U32CountingWriter;
+#endif
+
+    typedef BasicWriter<wchar_t>         WWriter;
+    typedef BasicOStreamWriter<wchar_t>  WOStreamWriter;
+    typedef BasicBufferWriter<wchar_t>   WBufferWriter;
+    typedef BasicPointerWriter<wchar_t>  WPointerWriter;
+    typedef BasicStringWriter<wchar_t>   WStringWriter;
+    typedef BasicCountingWriter<wchar_t> WCountingWriter;
+
+    // All formatting kernels write through this class. It keeps a pointer into a contiguous
+    // character buffer so that the common case (the data fits) is a plain copy. Only when the
+    // buffer is exhausted the virtual overflow() of the concrete writer is called.
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicWriter {
+    public:
+        typedef Char char_type;
+        typedef std::char_traits<Char> traits_type;
+
+        virtual ~BasicWriter() {}
+
+        inline void put(Char ch) {
+            if (m_pos != m_end) {
+                *m_pos ++ = ch;
+            }
+            else {
+                overflow(&ch, 1);
+            }
+        }
+
+        inline void write(const Char* str, std::size_t count) {
+            if (count <= (std::size_t)(m_end - m_pos)) {
+                traits_type::copy(m_pos, str, count);
+                m_pos += count;
+            }
+            else {
+                overflow(str, count);
+            }
+        }
+
+        // Writes count copies of ch, as one block while the buffer has room.
+        inline void fill(Char ch, std::size_t count) {
+            if (count <= (std::size_t)(m_end - m_pos)) {
+                traits_type::assign(m_pos, count, ch);
+                m_pos += count;
+            }
+            else {
+                fill_overflow(ch, count);
+            }
+        }
+
+        // Number of characters written so far, including characters a writer might have discarded.
+        inline std::size_t size() const {
+            return m_count + (m_pos - m_begin);
+        }
+
+        virtual void flush() {}
+
+    protected:
+        inline BasicWriter() : m_begin(nullptr), m_pos(nullptr), m_end(nullptr), m_count(0) {}
+        inline BasicWriter(Char* begin, Char* end) : m_begin(begin), m_pos(begin), m_end(end), m_count(0) {}
+
+        BasicWriter(const BasicWriter<Char>& other) = delete;
+        BasicWriter<Char>& operator= (const BasicWriter<Char>& other) = delete;
+
+        // Called when count characters do not fit into the remaining buffer. Implementations
+        // have to add everything they do not put into the buffer to m_count.
+        virtual void overflow(const Char* str, std::size_t count) = 0;
+
+        inline void setbuf(Char* begin, Char* end) {
+            m_count += m_pos - m_begin;
+            m_begin = m_pos = begin;
+            m_end   = end;
+        }
+
+        void fill_overflow(Char ch, std::size_t count);
+
+        Char*       m_begin;
+        Char*       m_pos;
+        Char*       m_end;
+        std::size_t m_count;
+    };
+
+    template<typename Char>
+    void BasicWriter<Char>::fill_overflow(Char ch, std::size_t count) {
+        // fill whatever room the buffer has, pass blocks to overflow() when there is none
+        Char block[64];
+        bool filled = false;
+        while (count > 0) {
+            std::size_t avail = m_end - m_pos;
+            if (avail > 0) {
+                avail = std::min(avail, count);
+                traits_type::assign(m_pos, avail, ch);
+                m_pos += avail;
+                count -= avail;
+            }
+            else {
+                if (!filled) {
+                    traits_type::assign(block, sizeof(block) / sizeof(Char), ch);
+                    filled = true;
+                }
+                avail = std::min(sizeof(block) / sizeof(Char), count);
+                overflow(block, avail);
+                count -= avail;
+            }
+        }
+    }
+
+    // Adapter for std::basic_ostream. Output is collected in a small buffer so that the stream
+    // (sentry, locale, virtual streambuf calls) is only touched once per flush.
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicOStreamWriter : public BasicWriter<Char> {
+    public:
+        typedef Char char_type;
+
+        static const std::size_t BUFFER_SIZE = 256;
+
+        explicit BasicOStreamWriter(std::basic_ostream<Char>& out) :
+            BasicWriter<Char>(m_buffer, m_buffer + BUFFER_SIZE), m_out(out) {}
+
+        virtual ~BasicOStreamWriter() {
+            try {
+                flush();
+            }
+            catch (...) {}
+        }
+
+        virtual void flush() {
+            std::size_t count = this->m_pos - m_buffer;
+            if (count > 0) {
+                this->setbuf(m_buffer, m_buffer + BUFFER_SIZE);
+                m_out.write(m_buffer, count);
+            }
+        }
+
+        inline std::basic_ostream<Char>& stream() const { return m_out; }
+
+    protected:
+        virtual void overflow(const Char* str, std::size_t count) {
+            flush();
+            if (count < BUFFER_SIZE) {
+                std::char_traits<Char>::copy(this->m_pos, str, count);
+                this->m_pos += count;
+            }
+            else {
+                this->m_count += count;
+                m_out.write(str, count);
+            }
+        }
+
+    private:
+        std::basic_ostream<Char>& m_out;
+        Char m_buffer[BUFFER_SIZE];
+    };
+
+    // The other direction: a std::basic_streambuf that passes everything to a BasicWriter, so
+    // operator<< can write to it without an intermediate string. Has no buffer of its own,
+    // the writer already has one.
+    template<typename Char>
+    class BasicWriterStreamBuf : public std::basic_streambuf<Char> {
+    public:
+        typedef Char char_type;
+        typedef typename std::basic_streambuf<Char>::int_type int_type;
+        typedef typename std::basic_streambuf<Char>::traits_type traits_type;
+
+        explicit BasicWriterStreamBuf(BasicWriter<Char>& out) : m_out(out) {}
+
+        inline BasicWriter<Char>& writer() const { return m_out; }
+
+    protected:
+        virtual int_type overflow(int_type ch) {
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                m_out.put(traits_type::to_char_type(ch));
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        virtual std::streamsize xsputn(const Char* str, std::streamsize count) {
+            m_out.write(str, (std::size_t)count);
+            return count;
+        }
+
+    private:
+        BasicWriter<Char>& m_out;
+    };
+
+    // Writes into caller provided memory. Output that does not fit is discarded, but still
+    // counted, so size() always reports the untruncated length. Never allocates.
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicBufferWriter : public BasicWriter<Char> {
+    public:
+        typedef Char char_type;
+
+        BasicBufferWriter(Char* buffer, std::size_t capacity) :
+            BasicWriter<Char>(buffer, buffer + capacity), m_capacity(capacity) {}
+
+        inline Char* data() const { return this->m_begin; }
+        inline std::size_t capacity() const { return m_capacity; }
+
+        // Number of characters actually stored in the buffer.
+        inline std::size_t length() const { return this->m_pos - this->m_begin; }
+        inline bool truncated() const { return this->m_count > 0; }
+
+    protected:
+        virtual void overflow(const Char* str, std::size_t count) {
+            std::size_t avail = this->m_end - this->m_pos;
+            std::char_traits<Char>::copy(this->m_pos, str, avail);
+            this->m_pos   += avail;
+            this->m_count += count - avail;
+        }
+
+    private:
+        std::size_t m_capacity;
+    };
+
+    // Writes to memory the caller guarantees to be large enough, like std::copy to a raw pointer.
+    // There is no end to check against, so every write goes through overflow().
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicPointerWriter : public BasicWriter<Char> {
+    public:
+        typedef Char char_type;
+
+        explicit BasicPointerWriter(Char* first) : BasicWriter<Char>(first, first) {}
+
+        // Position after the last written character.
+        inline Char* pos() const { return this->m_pos; }
+
+    protected:
+        virtual void overflow(const Char* str, std::size_t count) {
+            std::char_traits<Char>::copy(this->m_pos, str, count);
+            this->m_pos += count;
+            this->m_end  = this->m_pos;
+        }
+    };
+
+    // Appends to a std::basic_string. Characters are written in place into the strings storage,
+    // which is grown geometrically as needed. The string has its final size only after flush()
+    // (also called by the destructor).
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicStringWriter : public BasicWriter<Char> {
+    public:
+        typedef Char char_type;
+
+        explicit BasicStringWriter(std::basic_string<Char>& str) : m_str(str), m_length(str.size()) {}
+
+        virtual ~BasicStringWriter() {
+            flush();
+        }
+
+        virtual void flush() {
+            if (this->m_begin) {
+                m_length += this->m_pos - this->m_begin;
+                this->m_count += this->m_pos - this->m_begin;
+                this->m_begin = this->m_pos = this->m_end = nullptr;
+                m_str.resize(m_length);
+            }
+        }
+
+        inline std::basic_string<Char>& str() {
+            flush();
+            return m_str;
+        }
+
+    protected:
+        virtual void overflow(const Char* str, std::size_t count) {
+            std::size_t written = this->m_pos - this->m_begin;
+            std::size_t length  = m_length + written;
+            std::size_t size    = m_str.size() * 2;
+            if (size < length + count) {
+                size = length + count;
+            }
+            if (size < 64) {
+                size = 64;
+            }
+            m_str.resize(size);
+
+            Char* data = &m_str[0];
+            std::char_traits<Char>::copy(data + length, str, count);
+            this->m_count += written + count;
+            m_length = length + count;
+            this->m_begin = this->m_pos = data + m_length;
+            this->m_end = data + size;
+        }
+
+    private:
+        std::basic_string<Char>& m_str;
+        std::size_t m_length;
+    };
+
+    // Produces no output, only counts the characters. They are written into a small scratch
+    // buffer that is recycled whenever it is full, so most writes take the non-virtual path.
+    template<typename Char>
+    class FORMATSTRING_EXPORT BasicCountingWriter : public BasicWriter<Char> {
+    public:
+        typedef Char char_type;
+
+        static const std::size_t BUFFER_SIZE = 64;
+
+        BasicCountingWriter() : BasicWriter<Char>(m_buffer, m_buffer + BUFFER_SIZE) {}
+
+    protected:
+        virtual void overflow(const Char* str, std::size_t count) {
+            (void)str;
+            this->setbuf(m_buffer, m_buffer + BUFFER_SIZE);
+            this->m_count += count;
+        }
+
+    private:
+        Char m_buffer[BUFFER_SIZE];
+    };
+
+    // ---- extern template instantiations ----
+    extern template class FORMATSTRING_EXPORT BasicWriter<char>;
+    extern template class FORMATSTRING_EXPORT BasicOStreamWriter<char>;
+    extern template class FORMATSTRING_EXPORT BasicBufferWriter<char>;
+    extern template class FORMATSTRING_EXPORT BasicPointerWriter<char>;
+    extern template class FORMATSTRING_EXPORT BasicStringWriter<char>;
+    extern template class FORMATSTRING_EXPORT BasicCountingWriter<char>;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicWriter<char16_t>;
+    extern template class FORMATSTRING_EXPORT BasicOStreamWriter<char16_t>;
+    extern template class FORMATSTRING_EXPORT BasicBufferWriter<char16_t>;
+    extern template class FORMATSTRING_EXPORT BasicPointerWriter<char16_t>;
+    extern template class FORMATSTRING_EXPORT BasicStringWriter<char16_t>;
+    extern template class FORMATSTRING_EXPORT BasicCountingWriter<char16_t>;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+    extern template class FORMATSTRING_EXPORT BasicWriter<char32_t>;
+    extern template class FORMATSTRING_EXPORT BasicOStreamWriter<char32_t>;
+    extern template class FORMATSTRING_EXPORT BasicBufferWriter<char32_t>;
+    extern template class FORMATSTRING_EXPORT BasicPointerWriter<char32_t>;
+    extern template class FORMATSTRING_EXPORT BasicStringWriter<char32_t>;
+    extern template class FORMATSTRING_EXPORT BasicCountingWriter<char32_t>;
+#endif
+
+    extern template class FORMATSTRING_EXPORT BasicWriter<wchar_t>;
+    extern template class FORMATSTRING_EXPORT BasicOStreamWriter<wchar_t>;
+    extern template class FORMATSTRING_EXPORT BasicBufferWriter<wchar_t>;
+    extern template class FORMATSTRING_EXPORT BasicPointerWriter<wchar_t>;
+    extern template class FORMATSTRING_EXPORT BasicStringWriter<wchar_t>;
+    extern template class FORMATSTRING_EXPORT BasicCountingWriter<wchar_t>;
+
+    // Writes to a file descriptor using the write() system call. Uses a fixed internal buffer and
+    // never allocates or throws, so it can be used e.g. from within a signal handler. The errno of
+    // the first failed write is remembered and all further output is discarded.
+    class FORMATSTRING_EXPORT FdWriter : public BasicWriter<char> {
+    public:
+        typedef char char_type;
+
+        static const std::size_t BUFFER_SIZE = 512;
+
+        explicit FdWriter(int fd) : BasicWriter<char>(m_buffer, m_buffer + BUFFER_SIZE), m_fd(fd), m_error(0) {}
+
+        virtual ~FdWriter();
+
+        virtual void flush();
+
+        inline int fd() const { return m_fd; }
+        inline int error() const { return m_error; }
+
+    protected:
+        virtual void overflow(const char* str, std::size_t count);
+
+    private:
+        void write_fd(const char* str, std::size_t count);
+
+        int  m_fd;
+        int  m_error;
+        char m_buffer[BUFFER_SIZE];
+    };
+}
+
+#endif // FORMATSTRING_WRITER_H
@@ -0,0 +1,46 @@
+#ifndef FORMATSTRING_FLOATDIGITS_H
+#define FORMATSTRING_FLOATDIGITS_H
+#pragma once
+
+#include <cstdint>
+
+#include "formatstring/config.h"
+
+// Internal to the library: digit generation for floating point numbers.
+
+namespace formatstring {
+    namespace impl {
+        // value == significand * 10^exponent
+        struct decimal_fp {
+            std::uint64_t significand;
+            int exponent;
+        };
+
+        // The shortest decimal that reads back as the same value. If there are several the
+        // one closest to value is returned. The significand has no trailing zeros.
+        // value has to be finite and greater than zero.
+        decimal_fp shortest_decimal(double value);
+        decimal_fp shortest_decimal(float value);
+
+        // value == significand * 2^exponent
+        struct binary_fp {
+            std::uint64_t significand;
+            int exponent;
+        };
+
+        // value has to be finite and not negative. The long double overload is only exact if
+        // long double has at most 64 significant bits.
+        binary_fp to_binary(float value);
+        binary_fp to_binary(double value);
+        binary_fp to_binary(long double value);
+
+        // Correctly rounded decimal digits (ties to even) with value == 0.digits * 10^point
+        // fixed: the digits of the integral part (none for zero) and precision fractional
+        // digits, one more if the rounding carries into a new integral digit.
+        // otherwise: precision + 1 significant digits.
+        // Returns the digit count.
+        int exact_digits(char* digits, int& point, binary_fp value, int precision, bool fixed);
+    }
+}
+
+#endif
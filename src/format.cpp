@@ -1,406 +1,134 @@
 #include "formatstring/format.h"
 #include "formatstring/formatspec.h"
+#include "formatstring/formatparser.h"
 #include "formatstring/exceptions.h"
 
-#include "strformatitem.h"
-#include "valueformatitem.h"
+#include <vector>
+#include <limits>
 
 using namespace formatstring;
 
-template<typename Char>
-static const Char* parse_size(const Char* ptr, std::size_t* numberptr) {
-    std::size_t number = 0;
-
-    // TODO: handle integer overflow
-    for (; *ptr; ++ ptr) {
-        char ch = *ptr;
-        if (ch < '0' || ch > '9') {
-            break;
-        }
-        number *= 10;
-        number += ch - '0';
-    }
-
-    *numberptr = number;
-
-    return ptr;
+void formatstring::impl::invalid_format_string(std::size_t pos, const char* what) {
+    throw InvalidFormatStringException(pos, what);
 }
 
-template<typename Char>
-static const Char* parse_spec_internal(const Char* fmt, const Char* ptr, BasicFormatSpec<Char>* spec) {
-    typedef BasicFormatSpec<Char> Spec;
-
-    if (!*ptr) {
-        return ptr;
-    }
-
-    bool precision = false;
-    bool fill = false;
-
-    switch (*(ptr + 1)) {
-    case '<':
-        spec->alignment = Spec::Left;
-        spec->fill = *ptr;
-        fill = true;
-        ptr += 2;
-        break;
-
-    case '>':
-        spec->alignment = Spec::Right;
-        spec->fill = *ptr;
-        fill = true;
-        ptr += 2;
-        break;
-
-    case '=':
-        spec->alignment = Spec::AfterSign;
-        spec->fill = *ptr;
-        fill = true;
-        ptr += 2;
-        break;
-
-    case '^':
-        spec->alignment = Spec::Center;
-        spec->fill = *ptr;
-        fill = true;
-        ptr += 2;
-        break;
-    }
-
-    switch (*ptr) {
-    case '+':
-        spec->sign = Spec::Always;
-        ++ ptr;
-        break;
-
-    case '-':
-        spec->sign = Spec::NegativeOnly;
-        ++ ptr;
-        break;
-
-    case ' ':
-        spec->sign = Spec::SpaceForPositive;
-        ++ ptr;
-        break;
-    }
-
-    if (*ptr == '#') {
-        spec->alternate = true;
-        ++ ptr;
-    }
-
-    if (*ptr == '0') {
-        if (!fill) {
-            spec->alignment = Spec::AfterSign;
-            spec->fill = '0';
-        }
-        ++ ptr;
-    }
-
-    std::size_t size = 0;
-    const Char* next = parse_size(ptr, &size);
-    if (next != ptr) {
-        spec->width = size;
-        ptr = next;
-    }
-
-    if (*ptr == ',') {
-        spec->thoudsandsSeperator = true;
-        ++ ptr;
-    }
-
-    if (*ptr == '.') {
-        ++ ptr;
-        if (!*ptr) {
-            throw InvalidFormatStringException(ptr - fmt, "expected number");
-        }
-        next = parse_size(ptr, &size);
-        if (next != ptr) {
-            spec->precision = size;
-            ptr = next;
-        }
-        precision = true;
-    }
-
-    Char type = *ptr;
-    switch (type) {
-    case 'a':
-    case 'A':
-        spec->type = Spec::HexFloat;
-        spec->upperCase = type == 'A';
-        if (!precision) {
-            spec->precision = 4;
-        }
-        ++ ptr;
-        break;
-
-    case 'b':
-    case 'B':
-        spec->type = Spec::Bin;
-        spec->upperCase = type == 'B';
-        ++ ptr;
-        break;
-
-    case 'c':
-        spec->type = Spec::Character;
-        ++ ptr;
-        break;
-
-    case 'd':
-        spec->type = Spec::Dec;
-        ++ ptr;
-        break;
-
-    case 'e':
-    case 'E':
-        spec->type = Spec::Exp;
-        spec->upperCase = type == 'E';
-        if (!precision) {
-            spec->precision = 6;
-        }
-        ++ ptr;
-        break;
-
-    case 'f':
-    case 'F':
-        spec->type = Spec::Fixed;
-        spec->upperCase = type == 'F';
-        if (!precision) {
-            spec->precision = 6;
-        }
-        ++ ptr;
-        break;
-
-    case 'g':
-    case 'G':
-        spec->type = Spec::General;
-        spec->upperCase = type == 'G';
-        if (!precision) {
-            spec->precision = 6;
-        }
-        ++ ptr;
-        break;
-
-    /*
-    case 'n':
-    case 'N':
-        optionsptr->type = Spec::LocaleAwareNumber;
-        spec->upperCase = type == 'N';
-        ++ ptr;
-        break;
-    */
-
-    case 'o':
-    case 'O':
-        spec->type = Spec::Oct;
-        spec->upperCase = type == 'O';
-        ++ ptr;
-        break;
-
-    case 's':
-    case 'S':
-        spec->type = Spec::String;
-        spec->upperCase = type == 'S';
-        ++ ptr;
-        break;
-
-    case 'x':
-    case 'X':
-        spec->type = Spec::Hex;
-        spec->upperCase = type == 'X';
-        ++ ptr;
-        break;
-
-    case '%':
-        spec->type = Spec::Percentage;
-        if (!precision) {
-            spec->precision = 6;
-        }
-        ++ ptr;
-        break;
-    }
-
-    if (spec->alignment == Spec::AfterSign && spec->isStringType()) {
-        throw std::invalid_argument("'=' alignment not allowed in string format specifier");
-    }
-
-    if (spec->thoudsandsSeperator &&
-            spec->type != Spec::Generic &&
-            spec->type != Spec::Dec &&
-            spec->type != Spec::Exp &&
-            spec->type != Spec::Fixed &&
-            spec->type != Spec::General &&
-            spec->type != Spec::Percentage) {
-        std::string msg = "Cannot specify ',' with '";
-        msg += (char)type;
-        msg += "'.";
-        throw std::invalid_argument(msg);
-    }
-
-    if (spec->alternate && spec->isStringType()) {
-        throw std::invalid_argument("Alternate form (#) not allowed in string format specifier");
-    }
-
-    if (precision && (!spec->isFloatType() && spec->type != Spec::Generic)) {
-        std::string msg = "Cannot specify '.' with '";
-        msg += (char)type;
-        msg += "'.";
-        throw std::invalid_argument(msg);
-    }
-
-    return ptr;
+void formatstring::impl::invalid_format_spec(const char* what) {
+    throw std::invalid_argument(what);
 }
 
-template<typename Char>
-BasicFormatItems<Char> formatstring::parse_format(const Char* fmt) {
-    // Format string similar to Python, but a bit more limited:
-    // https://docs.python.org/3/library/string.html#format-string-syntax
-    //
-    // And added "a" and "A" format specifier from C99 format strings and upper case variant of some more types.
-    //
-    // replacement_field ::=  "{" [arg_index] ["!" conversion] [":" format_spec] "}"
-    // arg_index         ::=  integer
-    // conversion        ::=  "r" | "s"
-    // format_spec       ::=  [[fill]align][sign][#][0][width][,][.precision][type]
-    // fill              ::=  <any character>
-    // align             ::=  "<" | ">" | "=" | "^"
-    // sign              ::=  "+" | "-" | " "
-    // width             ::=  integer
-    // precision         ::=  integer
-    // type              ::=  "b" | "B" | "c" | "d" | "e" | "E" | "f" | "F" | "g" | "G" | "n" | "o" | "O" | "s" | "S" | "x" | "X" | "%" | "a" | "A"
-
-    BasicFormatItems<Char> items;
-    const std::basic_string<Char> empty;
-    std::size_t currentIndex = 0;
-    std::basic_stringbuf<Char> buffer;
-    const Char* ptr = fmt;
-
-    while (*ptr) {
-        Char ch = *ptr;
-
-        switch (ch) {
-        case '{':
-            ++ ptr;
-            ch = *ptr;
-            if (ch == '{') {
-                buffer.sputc(ch);
-            }
-            else {
-                if (buffer.in_avail() > 0) {
-                    items.emplace_back(new BasicStrFormatItem<Char>(buffer.str()));
-                    buffer.str(empty);
-                }
-
-                // parse format
-                std::size_t index = currentIndex;
-                BasicFormatSpec<Char> spec;
-                Conversion conv = NoConv;
+void formatstring::impl::invalid_format_spec(char option, char type) {
+    std::string msg = "Cannot specify '";
+    msg += option;
+    msg += "' with '";
+    msg += type;
+    msg += "'.";
+    throw std::invalid_argument(msg);
+}
 
-                if (ch >= '0' && ch <= '9') {
-                    ptr = parse_size(ptr, &index);
-                    ch = *ptr;
-                }
-                else {
-                    ++ currentIndex;
-                }
+namespace {
+    // collects the parsed format string for BasicFormatItems
+    template<typename Char>
+    class FormatBuilder {
+    public:
+        typedef BasicFormatItem<Char> Item;
 
-                if (ch == '!') {
-                    ++ ptr;
-                    ch = *ptr;
-                    if (ch == 'r') {
-                        conv = ReprConv;
-                    }
-                    else if (ch == 's') {
-                        conv = StrConv;
-                    }
-                    else {
-                        throw InvalidFormatStringException(ptr - fmt, "expected 'r' or 's'");
-                    }
-                    ++ ptr;
-                    ch = *ptr;
-                }
+        FormatBuilder() : m_literalStart(0) {}
 
-                if (ch == ':') {
-                    ++ ptr;
-                    ptr = parse_spec_internal(fmt, ptr, &spec);
-                    ch = *ptr;
-                }
+        void append(Char ch) {
+            m_chars += ch;
+        }
 
-                if (ch != '}') {
-                    throw InvalidFormatStringException(ptr - fmt, "expected '}'");
+        // all literal text between two replacement fields (including escaped braces) is
+        // collected into one item that references the shared character pool
+        void flush() {
+            if (m_chars.size() > m_literalStart) {
+                if (m_chars.size() > std::numeric_limits<std::uint32_t>::max()) {
+                    throw std::length_error("format string too long");
                 }
-
-                items.emplace_back(new BasicValueFormatItem<Char>(index, conv, spec));
+                typename Item::LiteralData literal = {(std::uint32_t)m_literalStart, (std::uint32_t)(m_chars.size() - m_literalStart)};
+                m_items.push_back(Item(literal));
+                m_literalStart = m_chars.size();
             }
-            break;
+        }
 
-        case '}':
-            ++ ptr;
-            if (*ptr == '}') {
-                buffer.sputc(ch);
+        void value(std::size_t index, Conversion conv, const BasicFormatSpec<Char>& spec) {
+            // identical specs share one table entry
+            std::size_t specIndex = 0;
+            while (specIndex < m_specs.size() && !m_specs[specIndex].equals(spec)) {
+                ++ specIndex;
             }
-            else {
-                throw InvalidFormatStringException(ptr - fmt, "expected '}'");
+            if (specIndex == m_specs.size()) {
+                m_specs.push_back(spec);
             }
-            break;
+            typename Item::ValueData value = {(std::uint32_t)index, (std::uint32_t)specIndex};
+            m_items.push_back(Item(conv, value));
+        }
 
-        default:
-            buffer.sputc(ch);
-            break;
+        BasicFormatItems<Char> items() const {
+            return BasicFormatItems<Char>(m_items, m_specs, m_chars);
         }
-        ++ ptr;
-    }
 
-    if (buffer.in_avail() > 0) {
-        items.emplace_back(new BasicStrFormatItem<Char>(buffer.str()));
-    }
+    private:
+        std::vector<Item> m_items;
+        std::vector< BasicFormatSpec<Char> > m_specs;
+        std::basic_string<Char> m_chars;
+        std::size_t m_literalStart;
+    };
+}
 
-    return std::move(items);
+template<typename Char>
+BasicFormatItems<Char> formatstring::parse_format(const Char* fmt, bool customSpecs) {
+    FormatBuilder<Char> builder;
+    impl::parse_format_into(fmt, builder, customSpecs);
+    return builder.items();
 }
 
 template<typename Char>
 BasicFormatSpec<Char> formatstring::parse_spec(const Char* str) {
     BasicFormatSpec<Char> spec;
-    parse_spec_internal(str, str, &spec);
-    return std::move(spec);
+    const Char* end = impl::parse_spec_internal(str, str, &spec);
+    if (*end) {
+        impl::invalid_format_string(end - str, "expected end of format spec");
+    }
+    return spec;
 }
 
-template FormatItems parse_format<char>(const char* fmt);
+template FormatItems formatstring::parse_format<char>(const char* fmt, bool customSpecs);
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-template U16FormatItems parse_format<char16_t>(const char16_t* fmt);
+template U16FormatItems formatstring::parse_format<char16_t>(const char16_t* fmt, bool customSpecs);
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-template U32FormatItems parse_format<char32_t>(const char32_t* fmt);
+template U32FormatItems formatstring::parse_format<char32_t>(const char32_t* fmt, bool customSpecs);
 #endif
 
-template WFormatItems parse_format<wchar_t>(const wchar_t* fmt);
+template WFormatItems formatstring::parse_format<wchar_t>(const wchar_t* fmt, bool customSpecs);
 
-template FORMATSTRING_EXPORT FormatSpec parse_spec<char>(const char* str);
+template FORMATSTRING_EXPORT FormatSpec formatstring::parse_spec<char>(const char* str);
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-template FORMATSTRING_EXPORT U16FormatSpec parse_spec<char16_t>(const char16_t* str);
+template FORMATSTRING_EXPORT U16FormatSpec formatstring::parse_spec<char16_t>(const char16_t* str);
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-template FORMATSTRING_EXPORT U32FormatSpec parse_spec<char32_t>(const char32_t* str);
+template FORMATSTRING_EXPORT U32FormatSpec formatstring::parse_spec<char32_t>(const char32_t* str);
 #endif
 
-template FORMATSTRING_EXPORT WFormatSpec parse_spec<wchar_t>(const wchar_t* str);
+template FORMATSTRING_EXPORT WFormatSpec formatstring::parse_spec<wchar_t>(const wchar_t* str);
 
-template class BasicFormat<char>;
-template class BasicBoundFormat<char>;
+template class formatstring::BasicFormatItems<char>;
+template class formatstring::BasicFormat<char>;
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-template class BasicFormat<char16_t>;
-template class BasicBoundFormat<char16_t>;
+template class formatstring::BasicFormatItems<char16_t>;
+template class formatstring::BasicFormat<char16_t>;
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-template class BasicFormat<char32_t>;
-template class BasicBoundFormat<char32_t>;
+template class formatstring::BasicFormatItems<char32_t>;
+template class formatstring::BasicFormat<char32_t>;
 #endif
 
-template class BasicFormat<wchar_t>;
-template class BasicBoundFormat<wchar_t>;
+template class formatstring::BasicFormatItems<wchar_t>;
+template class formatstring::BasicFormat<wchar_t>;
@@ -0,0 +1,219 @@
+#include "formatstring/formatcache.h"
+#include "formatstring/format.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+using namespace formatstring;
+
+namespace {
+
+    template<typename Char>
+    struct CacheEntry {
+        typedef typename BasicFormatCache<Char>::items_type items_type;
+
+        const Char*             ptr;
+        std::size_t             hash;
+        std::basic_string<Char> key;
+        items_type              items;
+
+        CacheEntry() : ptr(nullptr), hash(0) {}
+
+        void reset() {
+            ptr  = nullptr;
+            hash = 0;
+            key.clear();
+            items.reset();
+        }
+
+        void assign(const Char* fmt, std::size_t fmthash, std::size_t length, const items_type& fmtitems) {
+            ptr   = fmt;
+            hash  = fmthash;
+            items = fmtitems;
+            key.assign(fmt, length);
+        }
+
+        // compares without reading past the end of either string
+        bool matches(const Char* fmt) const {
+            const Char* lhs = key.c_str();
+            while (*lhs && *lhs == *fmt) {
+                ++ lhs;
+                ++ fmt;
+            }
+            return *lhs == *fmt;
+        }
+
+        bool matches(const Char* fmt, std::size_t fmthash, std::size_t length) const {
+            return items && hash == fmthash && key.size() == length &&
+                   std::char_traits<Char>::compare(key.data(), fmt, length) == 0;
+        }
+    };
+
+    template<typename Char>
+    struct LocalCache;
+
+    template<typename Char>
+    struct SharedCache {
+        typedef typename BasicFormatCache<Char>::items_type items_type;
+
+        std::mutex                 mutex;
+        std::atomic<unsigned>      generation;
+        std::atomic<std::size_t>   misses;
+        std::size_t                retiredHits;
+        std::vector<LocalCache<Char>*> locals;
+        CacheEntry<Char>           entries[BasicFormatCache<Char>::SHARED_SIZE];
+
+        SharedCache() : generation(0), misses(0), retiredHits(0) {}
+    };
+
+    template<typename Char>
+    SharedCache<Char>& shared_cache() {
+        static SharedCache<Char> cache;
+        return cache;
+    }
+
+    // Hits are only ever written by the owning thread, so counting them doesn't make
+    // threads fight over one cache line. They are summed up when queried.
+    template<typename Char>
+    struct LocalCache {
+        unsigned                 generation;
+        std::atomic<std::size_t> hits;
+        CacheEntry<Char>         entries[BasicFormatCache<Char>::LOCAL_SIZE];
+
+        LocalCache() : generation(0), hits(0) {
+            SharedCache<Char>& shared = shared_cache<Char>();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            generation = shared.generation.load(std::memory_order_relaxed);
+            shared.locals.push_back(this);
+        }
+
+        ~LocalCache() {
+            SharedCache<Char>& shared = shared_cache<Char>();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            shared.retiredHits += hits.load(std::memory_order_relaxed);
+            shared.locals.erase(std::remove(shared.locals.begin(), shared.locals.end(), this), shared.locals.end());
+        }
+
+        void hit() {
+            hits.store(hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    template<typename Char>
+    LocalCache<Char>& local_cache() {
+        static thread_local LocalCache<Char> cache;
+        return cache;
+    }
+
+    // FNV-1a over the code units, also determines the length
+    template<typename Char>
+    std::size_t hash_format(const Char* fmt, std::size_t* lengthptr) {
+        std::uint64_t hash = 14695981039346656037ull;
+        const Char* ptr = fmt;
+        for (; *ptr; ++ ptr) {
+            hash ^= (std::uint64_t)(typename std::make_unsigned<Char>::type)*ptr;
+            hash *= 1099511628211ull;
+        }
+        *lengthptr = ptr - fmt;
+        return (std::size_t)(hash ^ (hash >> 32));
+    }
+
+    inline std::size_t hash_pointer(const void* ptr) {
+        std::uintptr_t value = reinterpret_cast<std::uintptr_t>(ptr);
+        return (std::size_t)((value >> 4) ^ (value >> 12));
+    }
+}
+
+template<typename Char>
+typename BasicFormatCache<Char>::items_type BasicFormatCache<Char>::get(const Char* fmt) {
+    LocalCache<Char>&  local  = local_cache<Char>();
+    SharedCache<Char>& shared = shared_cache<Char>();
+
+    const unsigned generation = shared.generation.load(std::memory_order_acquire);
+    if (local.generation != generation) {
+        for (CacheEntry<Char>& entry : local.entries) {
+            entry.reset();
+        }
+        local.generation = generation;
+    }
+
+    CacheEntry<Char>& slot = local.entries[hash_pointer(fmt) % LOCAL_SIZE];
+    if (slot.ptr == fmt && slot.items && slot.matches(fmt)) {
+        local.hit();
+        return slot.items;
+    }
+
+    std::size_t length = 0;
+    const std::size_t hash = hash_format(fmt, &length);
+    CacheEntry<Char>& entry = shared.entries[hash % SHARED_SIZE];
+    items_type items;
+
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if (entry.matches(fmt, hash, length)) {
+            items = entry.items;
+        }
+    }
+
+    if (items) {
+        local.hit();
+    }
+    else {
+        // parse outside of the lock, a malformed format string throws here and is not cached
+        shared.misses.fetch_add(1, std::memory_order_relaxed);
+        items = std::make_shared<BasicFormatItems<Char>>(parse_format(fmt));
+
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        if (shared.generation.load(std::memory_order_relaxed) == generation) {
+            entry.assign(fmt, hash, length, items);
+        }
+    }
+
+    slot.assign(fmt, hash, length, items);
+
+    return items;
+}
+
+template<typename Char>
+std::size_t BasicFormatCache<Char>::hits() {
+    SharedCache<Char>& shared = shared_cache<Char>();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    std::size_t count = shared.retiredHits;
+    for (const LocalCache<Char>* local : shared.locals) {
+        count += local->hits.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+template<typename Char>
+std::size_t BasicFormatCache<Char>::misses() noexcept {
+    return shared_cache<Char>().misses.load(std::memory_order_relaxed);
+}
+
+template<typename Char>
+void BasicFormatCache<Char>::clear() {
+    SharedCache<Char>& shared = shared_cache<Char>();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (CacheEntry<Char>& entry : shared.entries) {
+        entry.reset();
+    }
+    // thread local tables notice this on their next lookup
+    shared.generation.fetch_add(1, std::memory_order_release);
+}
+
+template class formatstring::BasicFormatCache<char>;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+template class formatstring::BasicFormatCache<char16_t>;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+template class formatstring::BasicFormatCache<char32_t>;
+#endif
+
+template class formatstring::BasicFormatCache<wchar_t>;
@@ -2,19 +2,19 @@
 
 using namespace formatstring;
 
-template class BasicFormatSpec<char>;
+template class formatstring::BasicFormatSpec<char>;
 template<> const FormatSpec FormatSpec::DEFAULT = FormatSpec();
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-template class BasicFormatSpec<char16_t>;
+template class formatstring::BasicFormatSpec<char16_t>;
 template<> const U16FormatSpec U16FormatSpec::DEFAULT = U16FormatSpec();
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-template class BasicFormatSpec<char32_t>;
+template class formatstring::BasicFormatSpec<char32_t>;
 template<> const U32FormatSpec U32FormatSpec::DEFAULT = U32FormatSpec();
 #endif
 
-template class BasicFormatSpec<wchar_t>;
+template class formatstring::BasicFormatSpec<wchar_t>;
 template<> const WFormatSpec WFormatSpec::DEFAULT = WFormatSpec();
 
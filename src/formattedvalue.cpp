@@ -2,14 +2,14 @@
 
 using namespace formatstring;
 
-template class BasicFormattedValue<char>;
+template class formatstring::BasicFormattedValue<char>;
 
 #ifdef FORMATSTRING_CHAR16_SUPPORT
-template class BasicFormattedValue<char16_t>;
+template class formatstring::BasicFormattedValue<char16_t>;
 #endif
 
 #ifdef FORMATSTRING_CHAR32_SUPPORT
-template class BasicFormattedValue<char32_t>;
+template class formatstring::BasicFormattedValue<char32_t>;
 #endif
 
-template class BasicFormattedValue<wchar_t>;
+template class formatstring::BasicFormattedValue<wchar_t>;
@@ -1,40 +1,22 @@
 #include "formatstring/formatvalue.h"
+#include "floatdigits.h"
 
 #include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define FORMATSTRING_X86_SIMD 1
+#   include <immintrin.h>
+#endif
 
 namespace formatstring {
     namespace impl {
-        template<typename Char>
-        struct basic_grouping;
-
-        template<>
-        struct basic_grouping<char> {
-            static const std::locale non_grouping_locale;
-            static const std::locale thousands_grouping_locale;
-        };
-
-#ifdef FORMATSTRING_CHAR16_SUPPORT
-        template<>
-        struct basic_grouping<char16_t> {
-            static const std::locale non_grouping_locale;
-            static const std::locale thousands_grouping_locale;
-        };
-#endif
-
-#ifdef FORMATSTRING_CHAR32_SUPPORT
-        template<>
-        struct basic_grouping<char32_t> {
-            static const std::locale non_grouping_locale;
-            static const std::locale thousands_grouping_locale;
-        };
-#endif
-
-        template<>
-        struct basic_grouping<wchar_t> {
-            static const std::locale non_grouping_locale;
-            static const std::locale thousands_grouping_locale;
-        };
-
         template<typename Char>
         struct basic_names {
             typedef Char char_type;
@@ -59,37 +41,899 @@ namespace formatstring {
         typedef basic_names<wchar_t>  wnames;
 
         template<typename Char>
-        inline void fill(std::basic_ostream<Char>& out, Char fill, std::size_t width) {
-            for (; width > 0; -- width) { out.put(fill); }
+        inline void fill(BasicWriter<Char>& out, Char fill, std::size_t width) {
+            out.fill(fill, width);
         }
 
+        // Zero padding for '=' alignment with grouping: width characters that continue the
+        // separator pattern of the numlen characters that follow. Like Python one more '0'
+        // is written if the padding would start with a separator.
         template<typename Char>
-        void sepfill(std::basic_ostream<Char>& out, std::size_t width, std::size_t numlen) {
-            std::size_t place = width + numlen;
-            // (x % 4) == (x & 3)
-            if ((place & 3) == 0) {
+        void sepfill(BasicWriter<Char>& out, std::size_t width, std::size_t numlen, Char separator, unsigned int group) {
+            const std::size_t period = group + 1;
+            std::size_t lead = (width + numlen) % period;
+            if (lead == 0) {
                 out.put('0');
             }
-            for (; width > 0; -- width, -- place) {
-                if ((place & 3) == 0) {
-                    out.put(',');
+
+            // written in chunks of whole periods, each starting with a separator
+            Char chunk[128];
+            std::size_t chunklen = period <= sizeof(chunk) / sizeof(Char) ?
+                sizeof(chunk) / sizeof(Char) - (sizeof(chunk) / sizeof(Char)) % period :
+                sizeof(chunk) / sizeof(Char);
+            for (std::size_t index = 0; index < chunklen; ++ index) {
+                chunk[index] = index % period == 0 ? separator : '0';
+            }
+
+            if (period > chunklen) {
+                // very long groups: runs of zeros written from the chunk
+                std::size_t run = std::min(lead, width);
+                width -= run;
+                for (;;) {
+                    while (run > 0) {
+                        std::size_t count = std::min(run, chunklen - 1);
+                        out.write(chunk + 1, count);
+                        run -= count;
+                    }
+                    if (width == 0) {
+                        break;
+                    }
+                    out.put(separator);
+                    -- width;
+                    run = std::min((std::size_t)group, width);
+                    width -= run;
+                }
+                return;
+            }
+
+            // the zeros before the first separator, at most one group
+            std::size_t count = std::min(lead, width);
+            out.write(chunk + 1, count);
+            width -= count;
+
+            while (width >= chunklen) {
+                out.write(chunk, chunklen);
+                width -= chunklen;
+            }
+            out.write(chunk, width);
+        }
+
+        template<typename Char>
+        inline std::size_t sign_prefix(Char* prefix, bool negative, typename BasicFormatSpec<Char>::Sign sign) {
+            typedef BasicFormatSpec<Char> Spec;
+
+            switch (sign) {
+            case Spec::NegativeOnly:
+            case Spec::DefaultSign:
+                if (negative) {
+                    *prefix = '-';
+                    return 1;
+                }
+                break;
+
+            case Spec::Always:
+                *prefix = negative ? '-' : '+';
+                return 1;
+
+            case Spec::SpaceForPositive:
+                *prefix = negative ? '-' : ' ';
+                return 1;
+            }
+            return 0;
+        }
+
+        static const char* const LOWER_DIGITS = "0123456789abcdef";
+        static const char* const UPPER_DIGITS = "0123456789ABCDEF";
+
+        // "00" "01" ... "99", so that decimal conversion needs one division per two digits
+        static const char DIGIT_PAIRS[201] =
+            "0001020304050607080910111213141516171819"
+            "2021222324252627282930313233343536373839"
+            "4041424344454647484950515253545556575859"
+            "6061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        // binary digits of every nibble and octal digit pairs of every 6 bits
+        static const char BIN_NIBBLES[65] =
+            "0000000100100011010001010110011110001001101010111100110111101111";
+
+        static const char OCT_PAIRS[129] =
+            "0001020304050607101112131415161720212223242526273031323334353637"
+            "4041424344454647505152535455565760616263646566677071727374757677";
+
+        // Number of significant bits of value, at least 1.
+        template<typename UInt>
+        inline unsigned int bit_width(UInt value) {
+#if defined(__GNUC__)
+            return (unsigned int)(sizeof(unsigned long long) * 8) - (unsigned int)__builtin_clzll((unsigned long long)value | 1);
+#else
+            unsigned int width = 1;
+            while (value >>= 1) {
+                ++ width;
+            }
+            return width;
+#endif
+        }
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+        inline unsigned int bit_width(uint128 value) {
+            const std::uint64_t high = (std::uint64_t)(value >> 64);
+            return high != 0 ? 64 + bit_width(high) : bit_width((std::uint64_t)value);
+        }
+#endif
+
+        // The power of two bases: the number of digits follows from the highest set bit,
+        // then the digits are written backwards from end, several at a time from tables.
+        // Return a pointer to the first digit.
+        template<typename Char, typename UInt>
+        inline Char* format_hex(Char* end, UInt value, const char* digits) {
+            Char* first = end - (bit_width(value) + 3) / 4;
+            Char* ptr = end;
+            while (ptr - first >= 2) {
+                const unsigned int byte = (unsigned int)(value & 0xff);
+                *-- ptr = digits[byte & 0xf];
+                *-- ptr = digits[byte >> 4];
+                value >>= 8;
+            }
+            if (ptr != first) {
+                *-- ptr = digits[value & 0xf];
+            }
+            return first;
+        }
+
+        template<typename Char, typename UInt>
+        inline Char* format_oct(Char* end, UInt value) {
+            Char* first = end - (bit_width(value) + 2) / 3;
+            Char* ptr = end;
+            while (ptr - first >= 2) {
+                const char* pair = OCT_PAIRS + (value & 077) * 2;
+                *-- ptr = pair[1];
+                *-- ptr = pair[0];
+                value >>= 6;
+            }
+            if (ptr != first) {
+                *-- ptr = (Char)('0' + (value & 07));
+            }
+            return first;
+        }
+
+        template<typename Char, typename UInt>
+        inline Char* format_bin(Char* end, UInt value) {
+            Char* first = end - bit_width(value);
+            Char* ptr = end;
+            while (ptr - first >= 4) {
+                const char* bits = BIN_NIBBLES + (value & 0xf) * 4;
+                ptr -= 4;
+                ptr[0] = bits[0];
+                ptr[1] = bits[1];
+                ptr[2] = bits[2];
+                ptr[3] = bits[3];
+                value >>= 4;
+            }
+            while (ptr != first) {
+                *-- ptr = (Char)('0' + (value & 1));
+                value >>= 1;
+            }
+            return first;
+        }
+
+        template<typename Char>
+        inline Char* put_pair(Char* ptr, unsigned int pair) {
+            const char* digits = DIGIT_PAIRS + pair * 2;
+            *-- ptr = digits[1];
+            *-- ptr = digits[0];
+            return ptr;
+        }
+
+        // Writes the decimal digits of value backwards so that they end right before ptr,
+        // optionally with a separator between groups of three digits. Returns a pointer to
+        // the first digit.
+        template<typename Char, typename UInt>
+        inline Char* format_decimal_scalar(Char* ptr, UInt value, bool grouping, Char separator = ',') {
+            if (grouping) {
+                while (value >= 1000) {
+                    unsigned int group = (unsigned int)(value % 1000);
+                    value /= 1000;
+                    ptr = put_pair(ptr, group % 100);
+                    *-- ptr = (Char)('0' + group / 100);
+                    *-- ptr = separator;
+                }
+            }
+            else {
+                while (value >= 100) {
+                    ptr = put_pair(ptr, (unsigned int)(value % 100));
+                    value /= 100;
+                }
+            }
+
+            // at most three digits left when grouping, at most two otherwise
+            if (value >= 100) {
+                ptr = put_pair(ptr, (unsigned int)(value % 100));
+                value /= 100;
+            }
+            if (value >= 10) {
+                ptr = put_pair(ptr, (unsigned int)value);
+            }
+            else {
+                *-- ptr = (Char)('0' + value);
+            }
+            return ptr;
+        }
+
+        // ---- instruction set selection ----
+        enum simd_level {
+            SimdScalar,
+            SimdSSE2,
+            SimdAVX2
+        };
+
+        // The best level the CPU supports. The environment variable FORMATSTRING_SIMD
+        // ("scalar", "sse2" or "avx2") lowers it, so the tests can run every variant.
+        simd_level select_simd_level() {
+            simd_level level = SimdScalar;
+#ifdef FORMATSTRING_X86_SIMD
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                level = SimdAVX2;
+            }
+            else if (__builtin_cpu_supports("sse2")) {
+                level = SimdSSE2;
+            }
+#endif
+            const char* env = std::getenv("FORMATSTRING_SIMD");
+            if (env && std::strcmp(env, "scalar") == 0) {
+                level = SimdScalar;
+            }
+            else if (env && std::strcmp(env, "sse2") == 0) {
+                level = std::min(level, SimdSSE2);
+            }
+            return level;
+        }
+
+        // ---- 16 digits at once ----
+        // Writes the 16 decimal digits of value < 10^16 (with leading zeros) to out.
+        typedef void (*decimal16_func)(char* out, std::uint64_t value);
+
+        void decimal16_scalar(char* out, std::uint64_t value) {
+            std::uint32_t high = (std::uint32_t)(value / 100000000);
+            std::uint32_t low  = (std::uint32_t)(value % 100000000);
+            for (int index = 14; index >= 8; index -= 2) {
+                std::memcpy(out + index, DIGIT_PAIRS + (low % 100) * 2, 2);
+                low /= 100;
+            }
+            for (int index = 6; index >= 0; index -= 2) {
+                std::memcpy(out + index, DIGIT_PAIRS + (high % 100) * 2, 2);
+                high /= 100;
+            }
+        }
+
+#ifdef FORMATSTRING_X86_SIMD
+        // Converts two values < 10^8 at once, one per 64 bit half of each 128 bit lane, to
+        // one digit per 16 bit element (Wojciech Mula's multiply-shift scheme):
+        //   abcdefgh -> abcd, efgh        (multiply with 2^45/10^4, shift)
+        //   abcd -> a, ab, abc, abcd      (multiply-high with 2^k/10^n, twice)
+        //   a, ab, abc, abcd -> a, b, c, d (subtract 10 * the previous element)
+#   define FORMATSTRING_DIGITS8(VEC, PREFIX) \
+        const VEC abcd = PREFIX##_srli_epi64(PREFIX##_mul_epu32(abcdefgh, PREFIX##_set1_epi32((int)0xd1b71759)), 45); \
+        const VEC efgh = PREFIX##_sub_epi32(abcdefgh, PREFIX##_mul_epu32(abcd, PREFIX##_set1_epi32(10000))); \
+        const VEC v1   = PREFIX##_slli_epi64(PREFIX##_unpacklo_epi16(abcd, efgh), 2); \
+        const VEC v2a  = PREFIX##_unpacklo_epi16(v1, v1); \
+        const VEC v2   = PREFIX##_unpacklo_epi32(v2a, v2a); \
+        const VEC v3   = PREFIX##_mulhi_epu16(v2, PREFIX##_set1_epi64x(0x80003334147b20c5ll)); \
+        const VEC v4   = PREFIX##_mulhi_epu16(v3, PREFIX##_set1_epi64x(0x8000200008000080ll)); \
+        const VEC v5   = PREFIX##_slli_epi64(PREFIX##_mullo_epi16(v4, PREFIX##_set1_epi16(10)), 16); \
+        const VEC digits = PREFIX##_sub_epi16(v4, v5);
+
+        __attribute__((target("sse2")))
+        void decimal16_sse2(char* out, std::uint64_t value) {
+            __m128i packed;
+            {
+                const __m128i abcdefgh = _mm_cvtsi32_si128((int)(value / 100000000));
+                FORMATSTRING_DIGITS8(__m128i, _mm)
+                packed = digits;
+            }
+            {
+                const __m128i abcdefgh = _mm_cvtsi32_si128((int)(value % 100000000));
+                FORMATSTRING_DIGITS8(__m128i, _mm)
+                packed = _mm_packus_epi16(packed, digits);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(packed, _mm_set1_epi8('0')));
+        }
+
+        // both halves in one register, the high 8 digits in the low lane
+        __attribute__((target("avx2")))
+        void decimal16_avx2(char* out, std::uint64_t value) {
+            const __m256i abcdefgh = _mm256_setr_epi64x((long long)(value / 100000000), 0, (long long)(value % 100000000), 0);
+            FORMATSTRING_DIGITS8(__m256i, _mm256)
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(digits, digits), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(_mm256_castsi256_si128(packed), _mm_set1_epi8('0')));
+        }
+
+#   undef FORMATSTRING_DIGITS8
+#endif
+
+        decimal16_func select_decimal16() {
+            switch (select_simd_level()) {
+#ifdef FORMATSTRING_X86_SIMD
+            case SimdAVX2:
+                return &decimal16_avx2;
+
+            case SimdSSE2:
+                return &decimal16_sse2;
+#endif
+            default:
+                return &decimal16_scalar;
+            }
+        }
+
+        void decimal16_resolve(char* out, std::uint64_t value);
+
+        // Constant initialized, so formatting from other static initializers works too.
+        // The first call (or the selector below, at load time) replaces it.
+        static std::atomic<decimal16_func> decimal16(&decimal16_resolve);
+
+        void decimal16_resolve(char* out, std::uint64_t value) {
+            decimal16_func func = select_decimal16();
+            decimal16.store(func, std::memory_order_relaxed);
+            func(out, value);
+        }
+
+        static struct decimal16_selector {
+            decimal16_selector() {
+                decimal16.store(select_decimal16(), std::memory_order_relaxed);
+            }
+        } decimal16_selected;
+
+        template<typename Char>
+        inline Char* copy_digits(Char* ptr, const char* digits, std::size_t count) {
+            ptr -= count;
+            for (std::size_t index = 0; index < count; ++ index) {
+                ptr[index] = digits[index];
+            }
+            return ptr;
+        }
+
+        inline char* copy_digits(char* ptr, const char* digits, std::size_t count) {
+            ptr -= count;
+            std::memcpy(ptr, digits, count);
+            return ptr;
+        }
+
+        template<typename Char, typename UInt>
+        inline Char* format_decimal(Char* ptr, UInt value, std::false_type) {
+            return format_decimal_scalar(ptr, value, false);
+        }
+
+        // 64 bit values with more than 8 digits convert their low 16 digits at once
+        template<typename Char, typename UInt>
+        inline Char* format_decimal(Char* ptr, UInt value, std::true_type) {
+            if (value < 100000000) {
+                return format_decimal_scalar(ptr, value, false);
+            }
+
+            char digits[16];
+            const std::uint64_t top = (std::uint64_t)value / 10000000000000000ull;
+            decimal16.load(std::memory_order_relaxed)(digits, (std::uint64_t)value % 10000000000000000ull);
+
+            if (top == 0) {
+                // at least 9 digits
+                std::size_t skip = 0;
+                while (digits[skip] == '0') {
+                    ++ skip;
+                }
+                return copy_digits(ptr, digits + skip, 16 - skip);
+            }
+
+            ptr = copy_digits(ptr, digits, 16);
+            return format_decimal_scalar(ptr, (unsigned int)top, false);
+        }
+
+        template<typename Char, typename UInt>
+        inline Char* format_decimal(Char* ptr, UInt value) {
+            return format_decimal(ptr, value, std::integral_constant<bool, sizeof(UInt) == sizeof(std::uint64_t)>());
+        }
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+        // Exactly 19 digits, with leading zeros.
+        template<typename Char>
+        inline Char* format_decimal19(Char* ptr, std::uint64_t value) {
+            char digits[16];
+            const unsigned int top = (unsigned int)(value / 10000000000000000ull);
+            decimal16.load(std::memory_order_relaxed)(digits, value % 10000000000000000ull);
+            ptr = copy_digits(ptr, digits, 16);
+            ptr = put_pair(ptr, top % 100);
+            *-- ptr = (Char)('0' + top / 100);
+            return ptr;
+        }
+
+        // 128 bit values are split into chunks of 19 digits, so that only the divisions
+        // by 10^19 need 128 bit arithmetic.
+        template<typename Char>
+        inline Char* format_decimal(Char* ptr, uint128 value) {
+            const std::uint64_t CHUNK = 10000000000000000000ull;
+            while ((value >> 64) != 0) {
+                const uint128 high = value / CHUNK;
+                ptr = format_decimal19(ptr, (std::uint64_t)(value - high * CHUNK));
+                value = high;
+            }
+            return format_decimal(ptr, (std::uint64_t)value);
+        }
+#endif
+
+        // Writes the digits of value backwards so that they end right before ptr, with a
+        // separator between groups of group digits. Returns a pointer to the first digit.
+        template<typename Char, typename UInt>
+        inline Char* format_grouped(Char* ptr, UInt value, unsigned int base, Char separator, unsigned int group) {
+            unsigned int count = group;
+            for (;;) {
+                *-- ptr = (Char)('0' + value % base);
+                value /= base;
+                if (value == 0) {
+                    break;
+                }
+                if (-- count == 0) {
+                    *-- ptr = separator;
+                    count = group;
+                }
+            }
+            return ptr;
+        }
+
+        template<typename Char, typename UInt>
+        inline Char* format_decimal_grouped(Char* ptr, UInt value, Char separator, unsigned int group) {
+            return group == 3 ?
+                format_decimal_scalar(ptr, value, true, separator) :
+                format_grouped(ptr, value, 10, separator, group);
+        }
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+        // Converts without separators first, then copies the digits in front of ptr.
+        template<typename Char>
+        inline Char* format_decimal_grouped(Char* ptr, uint128 value, Char separator, unsigned int group) {
+            if ((value >> 64) == 0) {
+                return format_decimal_grouped(ptr, (std::uint64_t)value, separator, group);
+            }
+
+            Char digits[40];
+            Char* end = digits + sizeof(digits) / sizeof(Char);
+            const Char* first = format_decimal(end, value);
+            unsigned int count = 0;
+            while (end != first) {
+                if (count == group) {
+                    *-- ptr = separator;
+                    count = 0;
+                }
+                *-- ptr = *-- end;
+                ++ count;
+            }
+            return ptr;
+        }
+#endif
+
+        // Same for the power of two bases, which take shift bits per digit.
+        template<typename Char, typename UInt>
+        inline Char* format_grouped_pow2(Char* ptr, UInt value, unsigned int shift, const char* digits, Char separator, unsigned int group) {
+            const unsigned int mask = (1u << shift) - 1;
+            unsigned int count = group;
+            for (;;) {
+                *-- ptr = digits[value & mask];
+                value >>= shift;
+                if (value == 0) {
+                    break;
+                }
+                if (-- count == 0) {
+                    *-- ptr = separator;
+                    count = group;
+                }
+            }
+            return ptr;
+        }
+
+        // The float kernels produce ASCII, which is widened here for the other character types.
+        template<typename Char>
+        inline void write_chars(BasicWriter<Char>& out, const char* str, std::size_t count) {
+            for (; count > 0; -- count, ++ str) {
+                out.put(*str);
+            }
+        }
+
+        inline void write_chars(Writer& out, const char* str, std::size_t count) {
+            out.write(str, count);
+        }
+
+        // Like write_grouped(), but into a buffer. Returns the end.
+        template<typename Char>
+        Char* copy_grouped(Char* ptr, const char* str, std::size_t count, std::size_t intlen, Char separator, unsigned int group) {
+            std::size_t first = intlen <= group ? count : intlen % group;
+            if (first == 0) {
+                first = group;
+            }
+            ptr = std::copy(str, str + first, ptr);
+            if (first < count) {
+                for (std::size_t index = first; index < intlen; index += group) {
+                    *ptr ++ = separator;
+                    ptr = std::copy(str + index, str + index + group, ptr);
+                }
+                ptr = std::copy(str + intlen, str + count, ptr);
+            }
+            return ptr;
+        }
+
+        // Inserts a separator every group digits into the integral part (the first intlen
+        // characters).
+        template<typename Char>
+        void write_grouped(BasicWriter<Char>& out, const char* str, std::size_t count, std::size_t intlen, Char separator, unsigned int group) {
+            if (intlen <= group) {
+                write_chars(out, str, count);
+                return;
+            }
+            std::size_t first = intlen % group;
+            if (first == 0) {
+                first = group;
+            }
+            write_chars(out, str, first);
+            for (std::size_t index = first; index < intlen; index += group) {
+                out.put(separator);
+                write_chars(out, str + index, group);
+            }
+            write_chars(out, str + intlen, count - intlen);
+        }
+
+        // The number followed by zeros and a suffix that are not in its buffer.
+        template<typename Char>
+        inline void write_float(BasicWriter<Char>& out, const char* num, std::size_t numlen, std::size_t intlen, Char separator, unsigned int group,
+                std::size_t zeros, const char* suffix, std::size_t suffixlen) {
+            write_grouped(out, num, numlen, intlen, separator, group);
+            fill(out, (Char)'0', zeros);
+            write_chars(out, suffix, suffixlen);
+        }
+
+        // A negative precision is treated by snprintf as if it was omitted.
+        inline int print_float(char* buffer, std::size_t size, char type, int precision, double value) {
+            const char fmt[] = {'%', '.', '*', type, 0};
+            return std::snprintf(buffer, size, fmt, precision, value);
+        }
+
+        inline int print_float(char* buffer, std::size_t size, char type, int precision, long double value) {
+            const char fmt[] = {'%', '.', '*', 'L', type, 0};
+            return std::snprintf(buffer, size, fmt, precision, value);
+        }
+
+        // Splits the output of %e into its significant digits and the position of the decimal
+        // point: value == 0.digits * 10^point
+        // Works in place, digits may point to str.
+        inline int scientific_digits(char* digits, int& point, const char* str) {
+            int count = 0;
+            for (; *str != 'e'; ++ str) {
+                if (*str >= '0' && *str <= '9') {
+                    digits[count ++] = *str;
+                }
+            }
+            point = std::atoi(str + 1) + 1;
+            return count;
+        }
+
+        // Splits the output of %f the same way, a zero integral part is left out.
+        inline int fixed_digits(char* digits, int& point, const char* str) {
+            int count = 0;
+            point = -1;
+            for (; *str; ++ str) {
+                if (*str >= '0' && *str <= '9') {
+                    if (count > 0 || *str != '0' || point >= 0) {
+                        digits[count ++] = *str;
+                    }
+                }
+                else {
+                    point = count;
+                }
+            }
+            if (point < 0) {
+                point = count;
+            }
+            return count;
+        }
+
+        inline int strip_zeros(const char* digits, int count) {
+            while (count > 1 && digits[count - 1] == '0') {
+                -- count;
+            }
+            return count;
+        }
+
+        // The shortest digits that read back as value (value > 0).
+        template<typename Float>
+        inline int shortest_digits(char* digits, int& point, Float value) {
+            char buffer[24];
+            const decimal_fp dec = shortest_decimal(value);
+            char* end = buffer + sizeof(buffer);
+            char* begin = format_decimal(end, dec.significand);
+            int count = end - begin;
+            std::memcpy(digits, begin, count);
+            point = dec.exponent + count;
+            return count;
+        }
+
+        inline int shortest_digits(char* digits, int& point, long double value) {
+            if (std::numeric_limits<long double>::digits == std::numeric_limits<double>::digits) {
+                return shortest_digits(digits, point, (double)value);
+            }
+
+            // There are no tables for the wider formats. Instead the smallest precision that
+            // reads back is searched. More digits are never farther away from the value.
+            char buffer[64];
+            int low  = 1;
+            int high = std::numeric_limits<long double>::max_digits10;
+            while (low < high) {
+                int mid = (low + high) / 2;
+                print_float(buffer, sizeof(buffer), 'e', mid - 1, value);
+                if (std::strtold(buffer, nullptr) == value) {
+                    high = mid;
                 }
                 else {
-                    out.put('0');
+                    low = mid + 1;
+                }
+            }
+            print_float(buffer, sizeof(buffer), 'e', low - 1, value);
+            return strip_zeros(digits, scientific_digits(digits, point, buffer));
+        }
+
+        // See exact_digits(). size is the size of digits.
+        template<typename Float>
+        inline int precision_digits(char* digits, int& point, std::size_t size, Float value, int precision, bool fixed) {
+            (void)size;
+            return exact_digits(digits, point, to_binary(value), precision, fixed);
+        }
+
+        inline int precision_digits(char* digits, int& point, std::size_t size, long double value, int precision, bool fixed) {
+            if (std::numeric_limits<long double>::digits <= 64) {
+                return exact_digits(digits, point, to_binary(value), precision, fixed);
+            }
+
+            // the wider formats are left to snprintf
+            print_float(digits, size, fixed ? 'f' : 'e', precision, value);
+            return fixed ? fixed_digits(digits, point, digits) : scientific_digits(digits, point, digits);
+        }
+
+        // Lays out digits like Python does (format_float_short() in CPython's pystrtod.c).
+        // At least min_digits significant digits are written, add_dot_0 keeps a digit after the
+        // decimal point in fixed notation and alt keeps the decimal point itself.
+        inline std::size_t layout_float(char* out, const char* digits, int count, int point,
+                bool use_exp, int min_digits, bool add_dot_0, bool alt, bool upper) {
+            char* ptr = out;
+            int exponent = point - 1;
+            if (use_exp) {
+                point = 1;
+            }
+
+            int end = std::max(count, min_digits);
+            end = std::max(end, !use_exp && add_dot_0 ? point + 1 : point);
+
+            if (point <= 0) {
+                *ptr ++ = '0';
+                *ptr ++ = '.';
+                std::memset(ptr, '0', -point);
+                ptr += -point;
+                std::memcpy(ptr, digits, count);
+                ptr += count;
+            }
+            else if (point <= count) {
+                std::memcpy(ptr, digits, point);
+                ptr += point;
+                *ptr ++ = '.';
+                std::memcpy(ptr, digits + point, count - point);
+                ptr += count - point;
+            }
+            else {
+                std::memcpy(ptr, digits, count);
+                ptr += count;
+                std::memset(ptr, '0', point - count);
+                ptr += point - count;
+                *ptr ++ = '.';
+                count = point;
+            }
+            std::memset(ptr, '0', end - count);
+            ptr += end - count;
+
+            if (ptr[-1] == '.' && !alt) {
+                -- ptr;
+            }
+
+            if (use_exp) {
+                *ptr ++ = upper ? 'E' : 'e';
+                *ptr ++ = exponent < 0 ? '-' : '+';
+                unsigned int magnitude = exponent < 0 ? -exponent : exponent;
+                if (magnitude < 10) {
+                    *ptr ++ = '0';
+                }
+                char buffer[8];
+                char* begin = format_decimal(buffer + sizeof(buffer), magnitude);
+                std::size_t len = buffer + sizeof(buffer) - begin;
+                std::memcpy(ptr, begin, len);
+                ptr += len;
+            }
+
+            return ptr - out;
+        }
+
+        // Size of the digit and output buffers of format_general() and format_exact() for values
+        // below 2^exponent.
+        inline std::size_t digits_size(int exponent, int precision, bool fixed) {
+            // 1233 / 4096 is about log10(2)
+            const std::size_t intlen = fixed && exponent > 0 ? (std::size_t)((exponent * 1233) >> 12) + 1 : 1;
+            return intlen + (precision > 0 ? precision : 0) + 48;
+        }
+
+        template<typename Float>
+        inline std::size_t digits_size(Float value, int precision, bool fixed) {
+            int exponent = 0;
+            std::frexp(value, &exponent);
+            return digits_size(exponent, precision, fixed);
+        }
+
+        // Python's '' and 'g' presentation types for finite values >= 0. Without a precision ''
+        // is the shortest representation that reads back (repr()). With a precision ''
+        // behaves like 'g', but fixed notation keeps a digit after the decimal point.
+        // out and digits need digits_size(value, precision, false) chars.
+        template<typename Float>
+        std::size_t format_general(char* out, char* digits, std::size_t size, Float value, bool generic, int precision, bool alt, bool upper) {
+            const bool shortest = generic && precision < 0;
+            if (!shortest) {
+                precision = precision < 0 ? 6 : precision == 0 ? 1 : precision;
+            }
+
+            int point = 1;
+            int count = 1;
+            if (value == 0) {
+                digits[0] = '0';
+            }
+            else if (shortest) {
+                count = shortest_digits(digits, point, value);
+            }
+            else {
+                count = strip_zeros(digits, precision_digits(digits, point, size, value, precision - 1, false));
+            }
+
+            if (shortest) {
+                // like repr() switches at 1e16
+                return layout_float(out, digits, count, point, point <= -4 || point > 16, count, true, alt, upper);
+            }
+            bool use_exp = point <= -4 || point > (generic ? precision - 1 : precision);
+            return layout_float(out, digits, count, point, use_exp, alt ? precision : count, generic, alt, upper);
+        }
+
+        // The 'e', 'f' and '%' presentation types for finite values >= 0. The percentage is
+        // scaled by moving the decimal point of two more fractional digits.
+        // out and digits need digits_size(value, precision, !exp) chars.
+        template<typename Float>
+        std::size_t format_exact(char* out, char* digits, std::size_t size, Float value, bool exp, bool percent, int precision, bool alt, bool upper) {
+            if (precision < 0) {
+                precision = 6;
+            }
+
+            int point = 0;
+            int count = precision_digits(digits, point, size, value, percent ? precision + 2 : precision, !exp);
+            if (percent) {
+                point += 2;
+                while (point > 0 && *digits == '0') {
+                    ++ digits;
+                    -- count;
+                    -- point;
                 }
             }
+            return layout_float(out, digits, count, point, exp, count, false, alt, upper);
+        }
+
+        // All presentation types but 'a' for finite values >= 0.
+        // out and digits need digits_size(value, spec.precision, fixed) chars, where fixed is
+        // true for 'f' and '%'.
+        template<typename Char, typename Float>
+        inline std::size_t format_finite(char* out, char* digits, std::size_t size, Float value, const BasicFormatSpec<Char>& spec) {
+            typedef BasicFormatSpec<Char> Spec;
+
+            if (spec.type == Spec::Generic || spec.type == Spec::General) {
+                return format_general(out, digits, size, value, spec.type == Spec::Generic, spec.precision, spec.alternate, spec.upperCase);
+            }
+            return format_exact(out, digits, size, value, spec.type == Spec::Exp, spec.type == Spec::Percentage, spec.precision, spec.alternate, spec.upperCase);
+        }
+
+        // The 'a' presentation type for finite values >= 0, like printf's %a but with a leading
+        // 1 for all types (0 for zero and subnormal numbers). Without a precision all hex digits
+        // of the significand are written, otherwise they are rounded (ties to even) or padded.
+        // Padding zeros are only counted and the exponent ("p+1") goes to its own buffer, so out
+        // needs at most 18 chars and exponent 8 chars for any precision.
+        template<typename Float>
+        std::size_t format_hex_float(char* out, std::size_t& zeros, char* exponent, std::size_t& explen, Float value, int precision, bool alt, bool upper) {
+            typedef std::numeric_limits<Float> limits;
+
+            if (limits::digits > 64) {
+                throw std::runtime_error("hexfloat is not supported for this floating point format");
+            }
+
+            // the bits after the binary point, shifted left to fill whole hex digits
+            const int fraction_bits = limits::digits - 1;
+            const int nibbles = (fraction_bits + 3) / 4;
+            const binary_fp bin = to_binary(value);
+            unsigned int lead = 0;
+            std::uint64_t fraction = 0;
+            int exp2 = 0;
+            if (bin.significand != 0) {
+                std::uint64_t significand = bin.significand;
+                exp2 = bin.exponent + fraction_bits;
+                // to_binary() normalizes subnormal long doubles
+                if (exp2 < limits::min_exponent - 1) {
+                    significand >>= limits::min_exponent - 1 - exp2;
+                    exp2 = limits::min_exponent - 1;
+                }
+                lead = (unsigned int)(significand >> fraction_bits);
+                fraction = (significand & ((UINT64_C(1) << fraction_bits) - 1)) << (nibbles * 4 - fraction_bits);
+            }
+
+            int width = nibbles;
+            int count = nibbles;
+            zeros = 0;
+            if (precision < 0) {
+                while (count > 0 && (fraction & 0xf) == 0) {
+                    fraction >>= 4;
+                    -- count;
+                }
+                width = count;
+            }
+            else if (precision < nibbles) {
+                const int drop = (nibbles - precision) * 4;
+                const std::uint64_t rest = drop < 64 ? fraction & ((UINT64_C(1) << drop) - 1) : fraction;
+                const std::uint64_t half = UINT64_C(1) << (drop - 1);
+                fraction = drop < 64 ? fraction >> drop : 0;
+                width = count = precision;
+                if (rest > half || (rest == half && ((precision > 0 ? fraction : lead) & 1) != 0)) {
+                    if (precision > 0) {
+                        ++ fraction;
+                    }
+                    if (precision == 0 || fraction >> (precision * 4) != 0) {
+                        // carry into the leading digit
+                        fraction = 0;
+                        if (++ lead == 2) {
+                            lead = 1;
+                            ++ exp2;
+                        }
+                    }
+                }
+            }
+            else {
+                zeros = precision - nibbles;
+            }
+
+            const char* hex = upper ? UPPER_DIGITS : LOWER_DIGITS;
+            char* ptr = out;
+            *ptr ++ = hex[lead];
+            if (count > 0 || zeros > 0 || alt) {
+                *ptr ++ = '.';
+            }
+            for (int index = width - 1; index >= 0; -- index) {
+                *ptr ++ = hex[(fraction >> (index * 4)) & 0xf];
+            }
+
+            char* exp = exponent;
+            *exp ++ = upper ? 'P' : 'p';
+            *exp ++ = exp2 < 0 ? '-' : '+';
+            char buffer[8];
+            char* begin = format_decimal(buffer + sizeof(buffer), (unsigned int)(exp2 < 0 ? -exp2 : exp2));
+            std::size_t len = buffer + sizeof(buffer) - begin;
+            std::memcpy(exp, begin, len);
+            explen = exp + len - exponent;
+
+            return ptr - out;
         }
 
         template<typename Char>
         struct repr_char {
-            static inline void write_prefix(std::basic_ostream<Char>& out) {
+            static inline void write_prefix(BasicWriter<Char>& out) {
                 (void)out;
             }
         };
 
         template<>
         struct repr_char<wchar_t> {
-            static inline void write_prefix(std::wostream& out) {
+            static inline void write_prefix(WWriter& out) {
                 out.put('L');
             }
         };
@@ -97,7 +941,7 @@ namespace formatstring {
 #ifdef FORMATSTRING_CHAR16_SUPPORT
         template<>
         struct repr_char<char16_t> {
-            static inline void write_prefix(std::basic_ostream<char16_t>& out) {
+            static inline void write_prefix(BasicWriter<char16_t>& out) {
                 out.put('u');
             }
         };
@@ -106,11 +950,293 @@ namespace formatstring {
 #ifdef FORMATSTRING_CHAR32_SUPPORT
         template<>
         struct repr_char<char32_t> {
-            static inline void write_prefix(std::basic_ostream<char32_t>& out) {
+            static inline void write_prefix(BasicWriter<char32_t>& out) {
                 out.put('U');
             }
         };
 #endif
+
+        // ---- escape scanning ----
+        // Characters repr_string has to look at: the escaped control characters, '"', '\\'
+        // and '?' (trigraphs). Everything in between is copied as it is.
+        template<typename Char>
+        inline bool needs_escape(Char ch) {
+            switch (ch) {
+            case '\0': case '\a': case '\b': case '\t': case '\n': case '\v': case '\f': case '\r':
+            case '"': case '?': case '\\':
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        template<typename Char>
+        inline const Char* find_escape_scalar(const Char* begin, const Char* end) {
+            while (begin != end && !needs_escape(*begin)) {
+                ++ begin;
+            }
+            return begin;
+        }
+
+        typedef const char* (*find_escape_func)(const char* begin, const char* end);
+
+        const char* find_escape_chars(const char* begin, const char* end) {
+            return find_escape_scalar(begin, end);
+        }
+
+#ifdef FORMATSTRING_X86_SIMD
+        // Flags all bytes <= '\r' (not only the escaped ones) plus the three specials.
+        // The few false positives are written unchanged by repr_string.
+#   define FORMATSTRING_ESCAPES(VEC, PREFIX, chars) \
+        PREFIX##_or_si##VEC( \
+            PREFIX##_or_si##VEC( \
+                PREFIX##_cmpeq_epi8(PREFIX##_min_epu8(chars, PREFIX##_set1_epi8('\r')), chars), \
+                PREFIX##_cmpeq_epi8(chars, PREFIX##_set1_epi8('"'))), \
+            PREFIX##_or_si##VEC( \
+                PREFIX##_cmpeq_epi8(chars, PREFIX##_set1_epi8('?')), \
+                PREFIX##_cmpeq_epi8(chars, PREFIX##_set1_epi8('\\'))))
+
+        __attribute__((target("sse2")))
+        const char* find_escape_sse2(const char* begin, const char* end) {
+            for (; end - begin >= 16; begin += 16) {
+                const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                const int mask = _mm_movemask_epi8(FORMATSTRING_ESCAPES(128, _mm, chars));
+                if (mask != 0) {
+                    return begin + __builtin_ctz((unsigned int)mask);
+                }
+            }
+            return find_escape_scalar(begin, end);
+        }
+
+        __attribute__((target("avx2")))
+        const char* find_escape_avx2(const char* begin, const char* end) {
+            for (; end - begin >= 32; begin += 32) {
+                const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                const int mask = _mm256_movemask_epi8(FORMATSTRING_ESCAPES(256, _mm256, chars));
+                if (mask != 0) {
+                    return begin + __builtin_ctz((unsigned int)mask);
+                }
+            }
+            return find_escape_scalar(begin, end);
+        }
+
+#   undef FORMATSTRING_ESCAPES
+#endif
+
+        find_escape_func select_find_escape() {
+            switch (select_simd_level()) {
+#ifdef FORMATSTRING_X86_SIMD
+            case SimdAVX2:
+                return &find_escape_avx2;
+
+            case SimdSSE2:
+                return &find_escape_sse2;
+#endif
+            default:
+                return &find_escape_chars;
+            }
+        }
+
+        const char* find_escape_resolve(const char* begin, const char* end);
+
+        // Same scheme as decimal16 above.
+        static std::atomic<find_escape_func> find_escape_impl(&find_escape_resolve);
+
+        const char* find_escape_resolve(const char* begin, const char* end) {
+            find_escape_func func = select_find_escape();
+            find_escape_impl.store(func, std::memory_order_relaxed);
+            return func(begin, end);
+        }
+
+        static struct find_escape_selector {
+            find_escape_selector() {
+                find_escape_impl.store(select_find_escape(), std::memory_order_relaxed);
+            }
+        } find_escape_selected;
+
+        // The first character in [begin, end) repr_string has to look at, end if there is none.
+        template<typename Char>
+        inline const Char* find_escape(const Char* begin, const Char* end) {
+            return find_escape_scalar(begin, end);
+        }
+
+        inline const char* find_escape(const char* begin, const char* end) {
+            return find_escape_impl.load(std::memory_order_relaxed)(begin, end);
+        }
+
+        template<typename Char, typename T>
+        void format_each_value(BasicWriter<Char>& out, const T* values, std::size_t count, const BasicFormatSpec<Char>& spec,
+                               const Char* separator, std::size_t seplen) {
+            for (std::size_t index = 0; index < count; ++ index) {
+                if (index > 0) {
+                    out.write(separator, seplen);
+                }
+                format_value(out, values[index], spec);
+            }
+        }
+
+        // Decimal integers without padding are converted into one block that is written
+        // when full, everything else is formatted value by value.
+        template<typename Char, typename T>
+        void format_each(BasicWriter<Char>& out, const T* values, std::size_t count, const BasicFormatSpec<Char>& spec,
+                         const Char* separator, std::size_t seplen, std::true_type) {
+            typedef BasicFormatSpec<Char> Spec;
+            typedef typename std::make_unsigned<T>::type UInt;
+
+            // sign plus all bits of the number with a separator between every two of them
+            const std::size_t maxlen = 1 + sizeof(UInt) * 8 * 2;
+            Char block[512];
+            const std::size_t blocklen = sizeof(block) / sizeof(Char);
+
+            if (spec.width > 0 || (spec.type != Spec::Generic && spec.type != Spec::Dec) || seplen + maxlen > blocklen) {
+                format_each_value(out, values, count, spec, separator, seplen);
+                return;
+            }
+
+            const unsigned int group = spec.groupSize();
+            Char digits[maxlen];
+            Char* end = digits + maxlen;
+            std::size_t pos = 0;
+            for (std::size_t index = 0; index < count; ++ index) {
+                if (pos + seplen + maxlen > blocklen) {
+                    out.write(block, pos);
+                    pos = 0;
+                }
+                if (index > 0) {
+                    std::char_traits<Char>::copy(block + pos, separator, seplen);
+                    pos += seplen;
+                }
+
+                T value = values[index];
+                bool negative = value < 0;
+                UInt abs = negative ? -value : value;
+                pos += sign_prefix(block + pos, negative, spec.sign);
+
+                const Char* num = spec.thoudsandsSeperator ?
+                    format_decimal_grouped(end, abs, spec.separator, group) :
+                    format_decimal(end, abs);
+                std::char_traits<Char>::copy(block + pos, num, end - num);
+                pos += end - num;
+            }
+            out.write(block, pos);
+        }
+
+        // Largest binary exponent (as returned by frexp()) of the finite values. float and
+        // double read it from the bits in a loop that the compiler vectorizes.
+        template<typename Bits, typename Float>
+        inline int max_exponent_bits(const Float* values, std::size_t count) {
+            const int fraction_bits = std::numeric_limits<Float>::digits - 1;
+            const std::uint32_t mask = 2 * std::numeric_limits<Float>::max_exponent - 1;
+            std::uint32_t top = 0;
+            for (std::size_t index = 0; index < count; ++ index) {
+                Bits bits;
+                std::memcpy(&bits, values + index, sizeof(bits));
+                const std::uint32_t biased = (std::uint32_t)(bits >> fraction_bits) & mask;
+                top = std::max(top, biased == mask ? 0 : biased);
+            }
+            return (int)top - std::numeric_limits<Float>::max_exponent + 2;
+        }
+
+        inline int max_exponent(const float* values, std::size_t count) {
+            return max_exponent_bits<std::uint32_t>(values, count);
+        }
+
+        inline int max_exponent(const double* values, std::size_t count) {
+            return max_exponent_bits<std::uint64_t>(values, count);
+        }
+
+        inline int max_exponent(const long double* values, std::size_t count) {
+            int top = std::numeric_limits<long double>::min_exponent;
+            for (std::size_t index = 0; index < count; ++ index) {
+                if (std::isfinite(values[index])) {
+                    int exponent = 0;
+                    std::frexp(values[index], &exponent);
+                    top = std::max(top, exponent);
+                }
+            }
+            return top;
+        }
+
+        // Floating point numbers without padding are converted chunk by chunk into one block.
+        // The largest exponent of a chunk bounds the length of all its numbers, so they are
+        // converted without further size checks. Chunks of huge fixed point numbers or huge
+        // precisions and the 'a' presentation type are formatted value by value.
+        template<typename Char, typename Float>
+        void format_each(BasicWriter<Char>& out, const Float* values, std::size_t count, const BasicFormatSpec<Char>& spec,
+                         const Char* separator, std::size_t seplen, std::false_type) {
+            typedef BasicFormatSpec<Char> Spec;
+
+            Char block[1024];
+            const std::size_t blocklen = sizeof(block) / sizeof(Char);
+            char chars[512];
+            const std::size_t chunklen = 64;
+
+            if (spec.width > 0 || spec.type == Spec::HexFloat || (!spec.isFloatType() && spec.type != Spec::Generic)) {
+                format_each_value(out, values, count, spec, separator, seplen);
+                return;
+            }
+
+            const bool fixed = spec.type == Spec::Fixed || spec.type == Spec::Percentage;
+            const unsigned int group = spec.groupSize();
+            std::size_t pos = 0;
+            for (std::size_t start = 0; start < count; start += chunklen) {
+                const Float* chunk = values + start;
+                const std::size_t length = std::min(chunklen, count - start);
+                const std::size_t size = digits_size(max_exponent(chunk, length), spec.precision, fixed);
+                // sign, separators between all digits, '%' and the separator
+                const std::size_t maxlen = 1 + size * 2 + 1 + seplen;
+
+                if (size > sizeof(chars) / 2 || maxlen > blocklen) {
+                    out.write(block, pos);
+                    pos = 0;
+                    if (start > 0) {
+                        out.write(separator, seplen);
+                    }
+                    format_each_value(out, chunk, length, spec, separator, seplen);
+                    continue;
+                }
+
+                for (std::size_t index = 0; index < length; ++ index) {
+                    if (pos + maxlen > blocklen) {
+                        out.write(block, pos);
+                        pos = 0;
+                    }
+                    if (start + index > 0) {
+                        std::char_traits<Char>::copy(block + pos, separator, seplen);
+                        pos += seplen;
+                    }
+
+                    const Float value = chunk[index];
+                    const bool negative = std::signbit(value);
+                    const Float abs = negative ? -value : value;
+                    pos += sign_prefix(block + pos, negative, spec.sign);
+
+                    std::size_t numlen = 3;
+                    if (std::isnan(abs)) {
+                        std::char_traits<char>::copy(chars, spec.upperCase ? "NAN" : "nan", 3);
+                    }
+                    else if (std::isinf(abs)) {
+                        std::char_traits<char>::copy(chars, spec.upperCase ? "INF" : "inf", 3);
+                    }
+                    else {
+                        numlen = format_finite(chars, chars + sizeof(chars) / 2, size, abs, spec);
+                    }
+
+                    std::size_t intlen = 0;
+                    while (intlen < numlen && chars[intlen] >= '0' && chars[intlen] <= '9') {
+                        ++ intlen;
+                    }
+                    Char* end = spec.thoudsandsSeperator ?
+                        copy_grouped(block + pos, chars, numlen, intlen, spec.separator, group) :
+                        std::copy(chars, chars + numlen, block + pos);
+                    pos = end - block;
+                    if (spec.type == Spec::Percentage) {
+                        block[pos ++] = '%';
+                    }
+                }
+            }
+            out.write(block, pos);
+        }
     }
 }
 
@@ -141,19 +1267,7 @@ template<> const wchar_t* const impl::wnames::FALSE_LOWER = L"false";
 template<> const wchar_t* const impl::wnames::FALSE_UPPER = L"FALSE";
 
 template<typename Char>
-struct group_thousands : public std::numpunct<Char> {
-    std::string do_grouping() const { return "\03"; }
-    Char do_thousands_sep() const { return ','; }
-    Char do_decimal_point() const { return '.'; }
-};
-
-template<typename Char>
-struct no_grouping : public group_thousands<Char> {
-    std::string do_grouping() const { return ""; }
-};
-
-template<typename Char>
-void formatstring::repr_char(std::basic_ostream<Char>& out, Char value) {
+void formatstring::repr_char(BasicWriter<Char>& out, Char value) {
     impl::repr_char<Char>::write_prefix(out);
     out.put('\'');
     switch (value) {
@@ -173,10 +1287,24 @@ void formatstring::repr_char(std::basic_ostream<Char>& out, Char value) {
 }
 
 template<typename Char>
-void formatstring::repr_string(std::basic_ostream<Char>& out, const Char* value) {
+void formatstring::repr_string(BasicWriter<Char>& out, const Char* value) {
+    repr_string(out, value, std::char_traits<Char>::length(value));
+}
+
+template<typename Char>
+void formatstring::repr_string(BasicWriter<Char>& out, const Char* value, std::size_t length) {
+    const Char* end = value + length;
     impl::repr_char<Char>::write_prefix(out);
     out.put('"');
-    for (; *value; ++ value) {
+    for (; value != end; ++ value) {
+        // copy everything up to the next special character at once
+        const Char* next = impl::find_escape(value, end);
+        out.write(value, next - value);
+        if (next == end) {
+            break;
+        }
+        value = next;
+
         Char ch = *value;
         switch (ch) {
         case '\0': out.put('\\'); out.put('0'); break;
@@ -191,7 +1319,7 @@ void formatstring::repr_string(std::basic_ostream<Char>& out, const Char* value)
         case '?':
             // prevent trigraphs from being interpreted inside string literals
             out.put('?');
-            if (*(value + 1) == '?') {
+            if (value + 1 != end && *(value + 1) == '?') {
                 out.put('\\');
             }
             break;
@@ -204,7 +1332,7 @@ void formatstring::repr_string(std::basic_ostream<Char>& out, const Char* value)
 }
 
 template<typename Char>
-void formatstring::format_bool(std::basic_ostream<Char>& out, bool value, const BasicFormatSpec<Char>& spec) {
+void formatstring::format_bool(BasicWriter<Char>& out, bool value, const BasicFormatSpec<Char>& spec) {
     if (spec.isNumberType()) {
         format_integer<Char,unsigned int>(out, value ? 1 : 0, spec);
     }
@@ -219,20 +1347,20 @@ void formatstring::format_bool(std::basic_ostream<Char>& out, bool value, const
 }
 
 template<typename Char>
-void formatstring::repr_bool(std::basic_ostream<Char>& out, bool value) {
+void formatstring::repr_bool(BasicWriter<Char>& out, bool value) {
     const Char* str = value ? impl::basic_names<Char>::TRUE_LOWER : impl::basic_names<Char>::FALSE_LOWER;
     out.write(str, std::char_traits<Char>::length(str));
 }
 
-template<typename Char, typename Int, typename UInt = typename std::make_unsigned<Int>::type>
-void formatstring::format_integer(std::basic_ostream<Char>& out, Int value, const BasicFormatSpec<Char>& spec) {
+template<typename Char, typename Int, typename UInt>
+void formatstring::format_integer(BasicWriter<Char>& out, Int value, const BasicFormatSpec<Char>& spec) {
     typedef BasicFormatSpec<Char> Spec;
 
     if (spec.type == Spec::Character) {
-        Char str[2] = {(Char)value, 0};
+        Char str[1] = {(Char)value};
         Spec strspec = spec;
         strspec.type = Spec::String;
-        format_string(out, str, strspec);
+        format_string(out, str, 1, strspec);
         return;
     }
     else if (spec.isFloatType()) {
@@ -242,392 +1370,247 @@ void formatstring::format_integer(std::basic_ostream<Char>& out, Int value, cons
 
     bool negative = value < 0;
     UInt abs = negative ? -value : value;
-    std::basic_string<Char> prefix;
+    Char prefix[3];
+    std::size_t prefixlen = impl::sign_prefix(prefix, negative, spec.sign);
 
-    switch (spec.sign) {
-    case Spec::NegativeOnly:
-    case Spec::DefaultSign:
-        if (negative) {
-            prefix += (Char)'-';
-        }
-        break;
-
-    case Spec::Always:
-        prefix += negative ? (Char)'-' : (Char)'+';
-        break;
-
-    case Spec::SpaceForPositive:
-        prefix += negative ? (Char)'-' : (Char)' ';
-        break;
-    }
-
-    std::basic_ostringstream<Char> buffer;
-
-    buffer.imbue(spec.thoudsandsSeperator ? impl::basic_grouping<Char>::thousands_grouping_locale : impl::basic_grouping<Char>::non_grouping_locale);
+    // enough for all bits of the number plus a separator between every two of them
+    Char buffer[sizeof(UInt) * 8 * 2];
+    Char* end = buffer + sizeof(buffer) / sizeof(Char);
+    const char* digits = spec.upperCase ? impl::UPPER_DIGITS : impl::LOWER_DIGITS;
+    const Char* num = end;
 
     switch (spec.type) {
     case Spec::Generic:
     case Spec::Dec:
     case Spec::String:
-        buffer << abs;
+        num = spec.thoudsandsSeperator ?
+            impl::format_decimal_grouped(end, abs, spec.separator, spec.groupSize()) :
+            impl::format_decimal(end, abs);
         break;
 
     case Spec::Bin:
         if (spec.alternate) {
-            prefix += (Char)'0';
-            prefix += spec.upperCase ? (Char)'B' : (Char)'b';
-        }
-        if (abs == 0) {
-            buffer.put('0');
-        }
-        else {
-            UInt bit = (UInt)1 << ((sizeof(abs) * 8) - 1);
-            while ((abs & bit) == 0) {
-                bit >>= 1;
-            }
-
-            while (bit != 0) {
-                buffer.put((abs & bit) ? '1' : '0');
-                bit >>= 1;
-            }
+            prefix[prefixlen ++] = '0';
+            prefix[prefixlen ++] = spec.upperCase ? 'B' : 'b';
         }
+        num = spec.thoudsandsSeperator ?
+            impl::format_grouped_pow2(end, abs, 1, digits, spec.separator, spec.groupSize()) :
+            impl::format_bin(end, abs);
         break;
 
     case Spec::Oct:
         if (spec.alternate) {
-            prefix += (Char)'0';
-            prefix += spec.upperCase ? (Char)'O' : (Char)'o';
+            prefix[prefixlen ++] = '0';
+            prefix[prefixlen ++] = spec.upperCase ? 'O' : 'o';
         }
-        buffer.setf(std::ios::oct, std::ios::basefield);
-        buffer << abs;
+        num = spec.thoudsandsSeperator ?
+            impl::format_grouped_pow2(end, abs, 3, digits, spec.separator, spec.groupSize()) :
+            impl::format_oct(end, abs);
         break;
 
     case Spec::Hex:
         if (spec.alternate) {
-            prefix += (Char)'0';
-            prefix += spec.upperCase ? (Char)'X' : (Char)'x';
-        }
-        buffer.setf(std::ios::hex, std::ios::basefield);
-        if (spec.upperCase) {
-            buffer.setf(std::ios::uppercase);
+            prefix[prefixlen ++] = '0';
+            prefix[prefixlen ++] = spec.upperCase ? 'X' : 'x';
         }
-        buffer << abs;
+        num = spec.thoudsandsSeperator ?
+            impl::format_grouped_pow2(end, abs, 4, digits, spec.separator, spec.groupSize()) :
+            impl::format_hex(end, abs, digits);
         break;
 
     default:
         break;
     }
 
-    std::basic_string<Char> num = buffer.str();
-    typename std::basic_string<Char>::size_type length = prefix.size() + num.size();
+    std::size_t numlen = end - num;
+    std::size_t length = prefixlen + numlen;
 
-    if (length < spec.width) {
+    if (spec.width > 0 && length < (std::size_t)spec.width) {
         std::size_t padding = spec.width - length;
         switch (spec.alignment) {
         case Spec::Left:
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            out.write(num, numlen);
             impl::fill(out, spec.fill, padding);
             break;
 
         case Spec::Right:
         case Spec::DefaultAlignment:
             impl::fill(out, spec.fill, padding);
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            out.write(num, numlen);
             break;
 
         case Spec::Center:
         {
             std::size_t before = padding / 2;
             impl::fill(out, spec.fill, before);
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            out.write(num, numlen);
             impl::fill(out, spec.fill, padding - before);
             break;
         }
 
         case Spec::AfterSign:
-            out.write(prefix.c_str(), prefix.size());
+            out.write(prefix, prefixlen);
             if (spec.thoudsandsSeperator && spec.fill == '0') {
-                impl::sepfill(out, padding, num.size());
+                impl::sepfill(out, padding, numlen, spec.separator, spec.groupSize());
             }
             else {
                 impl::fill(out, spec.fill, padding);
             }
-            out.write(num.c_str(), num.size());
+            out.write(num, numlen);
             break;
         }
     }
     else {
-        out.write(prefix.c_str(), prefix.size());
-        out.write(num.c_str(), num.size());
+        out.write(prefix, prefixlen);
+        out.write(num, numlen);
     }
 }
 
-#if !defined(FORMATSTRING_IOS_HEXFLOAT_SUPPORT) && defined(FORMATSTRING_PRINTF_HEXFLOAT_SUPPORT)
-template<typename Float>
-inline std::string format_hexfloat(Float value, const FormatSpec& spec) {
-    if (spec.alignment == FormatSpec::AfterSign) {
-        if (spec.width > 3 && spec.fill != '0') {
-            throw std::runtime_error("unsupported hexfloat format for snprintf fallback");
-        }
-
-        const char *fmt = std::is_same<Float,long double>::value ?
-                (spec.upperCase ? "%0*.*LA" : "%0*.*La") :
-                (spec.upperCase ? "%0*.*A" : "%0*.*a");
-        std::size_t n = std::max(spec.width + 1, 64);
-        std::vector<char> buf(n, '\0');
-        int count = std::snprintf(buf.data(), n, fmt, spec.width, spec.precision, value);
-        if (count < 2 || count >= n) {
-            throw std::runtime_error("unexpected snprintf fail while processing hexfloat format");
-        }
-        return buf.data();
-    }
-
-    const char *fmt = std::is_same<Float,long double>::value ?
-            (spec.upperCase ? "%.*LA" : "%.*La") :
-            (spec.upperCase ? "%.*A" : "%.*a");
-    std::size_t n = std::max(spec.precision, 0) + 64;
-    std::vector<char> buf(n, '\0');
-    int count = std::snprintf(buf.data(), n, fmt, spec.precision, value);
-    if (count < 2 || count >= n) {
-        throw std::runtime_error("unexpected snprintf fail while processing hexfloat format");
-    }
-    return buf.data();
-}
-
-template<typename Float>
-inline std::wstring format_hexfloat(Float value, const WFormatSpec& spec) {
-    if (spec.alignment == WFormatSpec::AfterSign) {
-        if (spec.width > 3 && spec.fill != L'0') {
-            throw std::runtime_error("unsupported hexfloat format for swprintf fallback");
-        }
-
-        const wchar_t *fmt = std::is_same<Float,long double>::value ?
-                (spec.upperCase ? L"%0*.*LA" : L"%0*.*La") :
-                (spec.upperCase ? L"%0*.*A" : L"%0*.*a");
-        std::size_t n = std::max(spec.width + 1, 64);
-        std::vector<wchar_t> buf(n, '\0');
-        int count = std::swprintf(buf.data(), n, fmt, spec.width, spec.precision, value);
-        if (count < 2 || count >= n) {
-            throw std::runtime_error("unexpected printf fail while processing hexfloat format");
-        }
-        return buf.data();
-    }
-
-    const wchar_t *fmt = std::is_same<Float,long double>::value ?
-            (spec.upperCase ? L"%.*LA" : L"%.*La") :
-            (spec.upperCase ? L"%.*A" : L"%.*a");
-    std::size_t n = std::max(spec.width+1, 64);
-    std::vector<wchar_t> buf(n, '\0');
-    int count = std::swprintf(buf.data(), n, fmt, spec.precision, value);
-    if (count < 2 || count >= n) {
-        throw std::runtime_error("unexpected printf fail while processing hexfloat format");
+template<typename Char>
+void formatstring::check_float_spec(const BasicFormatSpec<Char>& spec) {
+    if (!spec.isFloatType() && spec.type != BasicFormatSpec<Char>::Generic) {
+        throw std::invalid_argument("Cannot use floating point numbers with non-decimal format specifier.");
     }
-    return buf.data();
-}
-
-#ifdef FORMATSTRING_CHAR16_SUPPORT
-template<typename Float>
-inline std::basic_string<char16_t> format_hexfloat(Float value, const U16FormatSpec& spec) {
-    (void)value;
-    (void)spec;
-    throw std::runtime_error("STL implementation does not support std::ios::hexfloat.");
-}
-#endif
-
-#ifdef FORMATSTRING_CHAR32_SUPPORT
-template<typename Float>
-inline std::basic_string<char32_t> format_hexfloat(Float value, const U32FormatSpec& spec) {
-    (void)value;
-    (void)spec;
-    throw std::runtime_error("STL implementation does not support std::ios::hexfloat.");
 }
-#endif
-#endif
 
 template<typename Char, typename Float>
-void formatstring::format_float(std::basic_ostream<Char>& out, Float value, const BasicFormatSpec<Char>& spec) {
+void formatstring::format_float(BasicWriter<Char>& out, Float value, const BasicFormatSpec<Char>& spec) {
     typedef BasicFormatSpec<Char> Spec;
 
-    if (!spec.isFloatType() && spec.type != Spec::Generic) {
-        throw std::invalid_argument("Cannot use floating point numbers with non-decimal format specifier.");
-    }
+    check_float_spec(spec);
 
     bool negative = std::signbit(value);
     Float abs = negative ? -value : value;
-    std::basic_string<Char> prefix;
-
-    switch (spec.sign) {
-    case Spec::NegativeOnly:
-    case Spec::DefaultSign:
-        if (negative) {
-            prefix += (Char)'-';
-        }
-        break;
-
-    case Spec::Always:
-        prefix += negative ? (Char)'-' : (Char)'+';
-        break;
-
-    case Spec::SpaceForPositive:
-        prefix += negative ? (Char)'-' : (Char)' ';
-        break;
-    }
-
-    std::basic_string<Char> num;
+    Char prefix[3];
+    std::size_t prefixlen = impl::sign_prefix(prefix, negative, spec.sign);
+
+    // Digits are printed into a stack buffer. Only numbers that do not fit (huge values with
+    // fixed notation or huge precisions) need a heap buffer.
+    char chars[512];
+    std::vector<char> heap;
+    char* num = chars;
+    std::size_t numlen = 0;
+    std::size_t intlen = 0;
+    bool percent = spec.type == Spec::Percentage;
+
+    // written after the number: zeros of a hexfloat's precision, then '%' or its exponent
+    std::size_t zeros = 0;
+    char suffix[8] = {'%'};
+    std::size_t suffixlen = percent ? 1 : 0;
 
     if (std::isnan(abs)) {
-        if (spec.upperCase) {
-            Char buffer[] = {'N', 'A', 'N', 0};
-            num = buffer;
-        }
-        else {
-            Char buffer[] = {'n', 'a', 'n', 0};
-            num = buffer;
-        }
-
-        if (spec.type == Spec::Percentage) {
-            num += (Char)'%';
-        }
+        std::char_traits<char>::copy(chars, spec.upperCase ? "NAN" : "nan", 3);
+        numlen = 3;
     }
     else if (std::isinf(abs)) {
-        if (spec.upperCase) {
-            Char buffer[] = {'I', 'N', 'F', 0};
-            num = buffer;
-        }
-        else {
-            Char buffer[] = {'i', 'n', 'f', 0};
-            num = buffer;
-        }
-
-        if (spec.type == Spec::Percentage) {
-            num += (Char)'%';
-        }
+        std::char_traits<char>::copy(chars, spec.upperCase ? "INF" : "inf", 3);
+        numlen = 3;
     }
-#if !defined(FORMATSTRING_IOS_HEXFLOAT_SUPPORT) && defined(FORMATSTRING_PRINTF_HEXFLOAT_SUPPORT)
     else if (spec.type == Spec::HexFloat) {
-        num = format_hexfloat(abs, spec);
+        prefix[prefixlen ++] = '0';
+        prefix[prefixlen ++] = spec.upperCase ? 'X' : 'x';
+        numlen = impl::format_hex_float(chars, zeros, suffix, suffixlen, abs, spec.precision, spec.alternate, spec.upperCase);
     }
-#endif
     else {
-        std::basic_ostringstream<Char> buffer;
-
-        buffer.imbue(spec.thoudsandsSeperator ? impl::basic_grouping<Char>::thousands_grouping_locale : impl::basic_grouping<Char>::non_grouping_locale);
-
-        if (spec.upperCase) {
-            buffer.setf(std::ios::uppercase);
-        }
-
-        switch (spec.type) {
-        case Spec::Exp:
-            buffer.setf(std::ios::scientific, std::ios::floatfield);
-            buffer.precision(spec.precision);
-            buffer << abs;
-            break;
-
-        case Spec::Fixed:
-            buffer.setf(std::ios::fixed, std::ios::floatfield);
-            buffer.precision(spec.precision);
-            buffer << abs;
-            break;
-
-        case Spec::Generic:
-        case Spec::General:
-        {
-            // XXX: not 100% correct. it doesn't skip trailing 0s after the decimal point
-            int exponent = std::log10(abs);
-            int precision = spec.precision < 1 ? 1 : spec.precision;
-            if (-4 <= exponent && exponent < precision) {
-                buffer.setf(std::ios::fixed, std::ios::floatfield);
-                precision = precision - 1 - exponent;
-            }
-            else {
-                buffer.setf(std::ios::scientific, std::ios::floatfield);
-                precision = precision - 1;
-            }
-            buffer.precision(precision);
-            buffer << abs;
-            break;
+        // the digits go into the second half of the buffer
+        const bool fixed = spec.type == Spec::Fixed || percent;
+        const std::size_t size = impl::digits_size(abs, spec.precision, fixed);
+        char* digits = chars + sizeof(chars) / 2;
+        if (size > sizeof(chars) / 2) {
+            heap.resize(size * 2);
+            num = heap.data();
+            digits = num + size;
         }
-        case Spec::Percentage:
-            buffer.setf(std::ios::fixed, std::ios::floatfield);
-            buffer.precision(spec.precision);
-            buffer << (abs * 100);
-            buffer.put('%');
-            break;
 
-        case Spec::HexFloat:
-#ifdef FORMATSTRING_IOS_HEXFLOAT_SUPPORT
-            buffer.setf(std::ios::hexfloat, std::ios::floatfield);
-            buffer.precision(spec.precision);
-            buffer << abs;
-            break;
-#else
-            throw std::runtime_error("STL implementation does not support std::ios::hexfloat.");
-#endif
-
-        default:
-            break;
-        }
+        numlen = impl::format_finite(num, digits, size, abs, spec);
+    }
 
-        num = buffer.str();
+    while (intlen < numlen && num[intlen] >= '0' && num[intlen] <= '9') {
+        ++ intlen;
     }
 
-    typename std::basic_string<Char>::size_type length = prefix.size() + num.size();
+    const unsigned int group = spec.groupSize();
+    std::size_t seps = spec.thoudsandsSeperator && intlen > 0 ? (intlen - 1) / group : 0;
+    std::size_t length = prefixlen + numlen + seps + zeros + suffixlen;
 
-    if (length < spec.width) {
+    if (spec.width > 0 && length < (std::size_t)spec.width) {
         std::size_t padding = spec.width - length;
         switch (spec.alignment) {
         case Spec::Left:
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            impl::write_float(out, num, numlen, seps ? intlen : 0, spec.separator, group, zeros, suffix, suffixlen);
             impl::fill(out, spec.fill, padding);
             break;
 
         case Spec::Right:
         case Spec::DefaultAlignment:
             impl::fill(out, spec.fill, padding);
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            impl::write_float(out, num, numlen, seps ? intlen : 0, spec.separator, group, zeros, suffix, suffixlen);
             break;
 
         case Spec::Center:
         {
             std::size_t before = padding / 2;
             impl::fill(out, spec.fill, before);
-            out.write(prefix.c_str(), prefix.size());
-            out.write(num.c_str(), num.size());
+            out.write(prefix, prefixlen);
+            impl::write_float(out, num, numlen, seps ? intlen : 0, spec.separator, group, zeros, suffix, suffixlen);
             impl::fill(out, spec.fill, padding - before);
             break;
         }
 
         case Spec::AfterSign:
-            out.write(prefix.c_str(), prefix.size());
-            if (spec.thoudsandsSeperator && spec.fill == '0' && std::isfinite(abs)) {
-                Char chars[] = { (Char)'.', (Char)'e', 0 };
-                if (spec.upperCase) {
-                    chars[1] = (Char)'E';
-                }
-                std::size_t pos = num.find_first_of(chars);
-                impl::sepfill(out, padding, pos == std::basic_string<Char>::npos ? num.size() : pos);
+            out.write(prefix, prefixlen);
+            if (spec.thoudsandsSeperator && spec.fill == '0' && std::isfinite(abs) && spec.type != Spec::HexFloat) {
+                impl::sepfill(out, padding, intlen + seps, spec.separator, group);
             }
             else {
                 impl::fill(out, spec.fill, padding);
             }
-            out.write(num.c_str(), num.size());
+            impl::write_float(out, num, numlen, seps ? intlen : 0, spec.separator, group, zeros, suffix, suffixlen);
             break;
         }
     }
     else {
-        out.write(prefix.c_str(), prefix.size());
-        out.write(num.c_str(), num.size());
+        out.write(prefix, prefixlen);
+        impl::write_float(out, num, numlen, seps ? intlen : 0, spec.separator, group, zeros, suffix, suffixlen);
+    }
+}
+
+template<typename Char, typename Float>
+void formatstring::repr_float(BasicWriter<Char>& out, Float value) {
+    // same as Python's repr(): the shortest representation that reads back as the same value
+    char chars[64];
+    char digits[64];
+    std::size_t count = 0;
+    if (std::signbit(value)) {
+        chars[count ++] = '-';
+        value = -value;
+    }
+    if (std::isnan(value)) {
+        std::char_traits<char>::copy(chars + count, "nan", 3);
+        count += 3;
+    }
+    else if (std::isinf(value)) {
+        std::char_traits<char>::copy(chars + count, "inf", 3);
+        count += 3;
+    }
+    else {
+        count += impl::format_general(chars + count, digits, sizeof(digits), value, true, -1, false, false);
     }
+    impl::write_chars(out, chars, count);
+}
+
+template<typename Char, typename T>
+void formatstring::format_each(BasicWriter<Char>& out, const T* values, std::size_t count, const BasicFormatSpec<Char>& spec, const Char* separator) {
+    impl::format_each(out, values, count, spec, separator, std::char_traits<Char>::length(separator), std::is_integral<T>());
 }
 
 template<typename Char>
-void formatstring::format_string(std::basic_ostream<Char>& out, const Char value[], const BasicFormatSpec<Char>& spec) {
+void formatstring::check_string_spec(const BasicFormatSpec<Char>& spec) {
     typedef BasicFormatSpec<Char> Spec;
 
     if (spec.sign != Spec::DefaultSign) {
@@ -635,7 +1618,9 @@ void formatstring::format_string(std::basic_ostream<Char>& out, const Char value
     }
 
     if (spec.thoudsandsSeperator) {
-        throw std::invalid_argument("Cannot specify ',' for string");
+        throw std::invalid_argument(spec.separator == '_' ?
+            "Cannot specify '_' for string" :
+            "Cannot specify ',' for string");
     }
 
     if (spec.alternate && spec.type != Spec::Character) {
@@ -650,8 +1635,19 @@ void formatstring::format_string(std::basic_ostream<Char>& out, const Char value
     default:
         throw std::invalid_argument("Invalid format specifier for string or character");
     }
+}
+
+template<typename Char>
+void formatstring::format_string(BasicWriter<Char>& out, const Char value[], const BasicFormatSpec<Char>& spec) {
+    format_string(out, value, std::char_traits<Char>::length(value), spec);
+}
+
+template<typename Char>
+void formatstring::format_string(BasicWriter<Char>& out, const Char value[], std::size_t length, const BasicFormatSpec<Char>& spec) {
+    typedef BasicFormatSpec<Char> Spec;
+
+    check_string_spec(spec);
 
-    std::size_t length = std::char_traits<Char>::length(value);
     if (spec.width > 0 && length < (std::size_t)spec.width) {
         std::size_t padding = spec.width - length;
         switch (spec.alignment) {
@@ -683,141 +1679,231 @@ void formatstring::format_string(std::basic_ostream<Char>& out, const Char value
 }
 
 template<typename Char>
-void formatstring::format_int_char(std::basic_ostream<Char>& out, typename std::char_traits<Char>::int_type value, const BasicFormatSpec<Char>& spec) {
+void formatstring::format_int_char(BasicWriter<Char>& out, typename std::char_traits<Char>::int_type value, const BasicFormatSpec<Char>& spec) {
     if (spec.type == BasicFormatSpec<Char>::Generic || spec.isStringType()) {
-        Char str[2] = { (Char)value, 0 };
+        Char str[1] = { (Char)value };
         BasicFormatSpec<Char> strspec = spec;
         strspec.type = BasicFormatSpec<Char>::String;
-        format_string(out, str, strspec);
+        format_string(out, str, 1, strspec);
     }
     else {
         format_integer(out, value, spec);
     }
 }
 
-template void repr_bool<char>(std::ostream& out, bool value);
-template void repr_bool<wchar_t>(std::wostream& out, bool value);
+template void formatstring::repr_bool<char>(Writer& out, bool value);
+template void formatstring::repr_bool<wchar_t>(WWriter& out, bool value);
 
-template void repr_char<char>(std::ostream& out, char value);
-template void repr_char<wchar_t>(std::wostream& out, wchar_t value);
+template void formatstring::repr_char<char>(Writer& out, char value);
+template void formatstring::repr_char<wchar_t>(WWriter& out, wchar_t value);
 
-template void repr_string<char>(std::ostream& out, const char* value);
-template void repr_string<wchar_t>(std::wostream& out, const wchar_t* value);
+template void formatstring::repr_string<char>(Writer& out, const char* value);
+template void formatstring::repr_string<char>(Writer& out, const char* value, std::size_t length);
+template void formatstring::repr_string<wchar_t>(WWriter& out, const wchar_t* value);
+template void formatstring::repr_string<wchar_t>(WWriter& out, const wchar_t* value, std::size_t length);
 
-template void format_bool<char>(std::ostream& out, bool value, const FormatSpec& spec);
-template void format_bool<wchar_t>(std::wostream& out, bool value, const WFormatSpec& spec);
+template void formatstring::format_bool<char>(Writer& out, bool value, const FormatSpec& spec);
+template void formatstring::format_bool<wchar_t>(WWriter& out, bool value, const WFormatSpec& spec);
 
-template void format_int_char<char>(std::ostream& out, std::char_traits<char>::int_type value, const FormatSpec& spec);
-template void format_int_char<wchar_t>(std::wostream& out, std::char_traits<wchar_t>::int_type value, const WFormatSpec& spec);
+template void formatstring::format_int_char<char>(Writer& out, std::char_traits<char>::int_type value, const FormatSpec& spec);
+template void formatstring::format_int_char<wchar_t>(WWriter& out, std::char_traits<wchar_t>::int_type value, const WFormatSpec& spec);
 
-template void format_string<char>(std::ostream& out, const char value[], const FormatSpec& spec);
-template void format_string<wchar_t>(std::wostream& out, const wchar_t value[], const WFormatSpec& spec);
+template void formatstring::format_string<char>(Writer& out, const char value[], const FormatSpec& spec);
+template void formatstring::format_string<char>(Writer& out, const char value[], std::size_t length, const FormatSpec& spec);
+template void formatstring::format_string<wchar_t>(WWriter& out, const wchar_t value[], const WFormatSpec& spec);
+template void formatstring::format_string<wchar_t>(WWriter& out, const wchar_t value[], std::size_t length, const WFormatSpec& spec);
 
-template void format_float<char,float>(std::ostream& out, float value, const FormatSpec& spec);
-template void format_float<wchar_t,float>(std::wostream& out, float value, const WFormatSpec& spec);
+template void formatstring::check_string_spec<char>(const FormatSpec& spec);
+template void formatstring::check_string_spec<wchar_t>(const WFormatSpec& spec);
 
-template void format_float<char,double>(std::ostream& out, double value, const FormatSpec& spec);
-template void format_float<wchar_t,double>(std::wostream& out, double value, const WFormatSpec& spec);
+template void formatstring::check_float_spec<char>(const FormatSpec& spec);
+template void formatstring::check_float_spec<wchar_t>(const WFormatSpec& spec);
 
-template void format_float<char,long double>(std::ostream& out, long double value, const FormatSpec& spec);
-template void format_float<wchar_t,long double>(std::wostream& out, long double value, const WFormatSpec& spec);
+template void formatstring::repr_float<char,float>(Writer& out, float value);
+template void formatstring::repr_float<wchar_t,float>(WWriter& out, float value);
 
-template void format_integer<char,char>(std::ostream& out, char value, const FormatSpec& spec);
-template void format_integer<char,short>(std::ostream& out, short value, const FormatSpec& spec);
-template void format_integer<char,int>(std::ostream& out, int value, const FormatSpec& spec);
-template void format_integer<char,long>(std::ostream& out, long value, const FormatSpec& spec);
-template void format_integer<char,long long>(std::ostream& out, long long value, const FormatSpec& spec);
+template void formatstring::repr_float<char,double>(Writer& out, double value);
+template void formatstring::repr_float<wchar_t,double>(WWriter& out, double value);
 
-template void format_integer<char,signed char>(std::ostream& out, signed char value, const FormatSpec& spec);
-template void format_integer<char,unsigned char>(std::ostream& out, unsigned char value, const FormatSpec& spec);
-template void format_integer<char,unsigned short>(std::ostream& out, unsigned short value, const FormatSpec& spec);
-template void format_integer<char,unsigned int>(std::ostream& out, unsigned int value, const FormatSpec& spec);
-template void format_integer<char,unsigned long>(std::ostream& out, unsigned long value, const FormatSpec& spec);
-template void format_integer<char,unsigned long long>(std::ostream& out, unsigned long long value, const FormatSpec& spec);
+template void formatstring::repr_float<char,long double>(Writer& out, long double value);
+template void formatstring::repr_float<wchar_t,long double>(WWriter& out, long double value);
 
-template void format_integer<wchar_t,wchar_t>(std::wostream& out, wchar_t value, const WFormatSpec& spec);
+template void formatstring::format_float<char,float>(Writer& out, float value, const FormatSpec& spec);
+template void formatstring::format_float<wchar_t,float>(WWriter& out, float value, const WFormatSpec& spec);
 
-template void format_integer<wchar_t,char>(std::wostream& out, char value, const WFormatSpec& spec);
-template void format_integer<wchar_t,short>(std::wostream& out, short value, const WFormatSpec& spec);
-template void format_integer<wchar_t,int>(std::wostream& out, int value, const WFormatSpec& spec);
-template void format_integer<wchar_t,long>(std::wostream& out, long value, const WFormatSpec& spec);
-template void format_integer<wchar_t,long long>(std::wostream& out, long long value, const WFormatSpec& spec);
+template void formatstring::format_float<char,double>(Writer& out, double value, const FormatSpec& spec);
+template void formatstring::format_float<wchar_t,double>(WWriter& out, double value, const WFormatSpec& spec);
 
-template void format_integer<wchar_t,signed char>(std::wostream& out, signed char value, const WFormatSpec& spec);
-template void format_integer<wchar_t,unsigned char>(std::wostream& out, unsigned char value, const WFormatSpec& spec);
-template void format_integer<wchar_t,unsigned short>(std::wostream& out, unsigned short value, const WFormatSpec& spec);
-template void format_integer<wchar_t,unsigned int>(std::wostream& out, unsigned int value, const WFormatSpec& spec);
-template void format_integer<wchar_t,unsigned long>(std::wostream& out, unsigned long value, const WFormatSpec& spec);
-template void format_integer<wchar_t,unsigned long long>(std::wostream& out, unsigned long long value, const WFormatSpec& spec);
+template void formatstring::format_float<char,long double>(Writer& out, long double value, const FormatSpec& spec);
+template void formatstring::format_float<wchar_t,long double>(WWriter& out, long double value, const WFormatSpec& spec);
 
-const std::locale impl::basic_grouping<char>::non_grouping_locale(std::locale(), new no_grouping<char>());
-const std::locale impl::basic_grouping<char>::thousands_grouping_locale(std::locale(), new group_thousands<char>());
-
-#ifdef FORMATSTRING_CHAR16_SUPPORT
-template void repr_bool<char16_t>(std::basic_ostream<char16_t>& out, bool value);
-template void repr_char<char16_t>(std::basic_ostream<char16_t>& out, char16_t value);
-template void repr_string<char16_t>(std::basic_stream<char16_t>& out, const char16_t* value);
+template void formatstring::format_integer<char,char>(Writer& out, char value, const FormatSpec& spec);
+template void formatstring::format_integer<char,short>(Writer& out, short value, const FormatSpec& spec);
+template void formatstring::format_integer<char,int>(Writer& out, int value, const FormatSpec& spec);
+template void formatstring::format_integer<char,long>(Writer& out, long value, const FormatSpec& spec);
+template void formatstring::format_integer<char,long long>(Writer& out, long long value, const FormatSpec& spec);
 
-template void format_bool<char16_t>(std::basic_stream<char16_t>& out, bool value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char,signed char>(Writer& out, signed char value, const FormatSpec& spec);
+template void formatstring::format_integer<char,unsigned char>(Writer& out, unsigned char value, const FormatSpec& spec);
+template void formatstring::format_integer<char,unsigned short>(Writer& out, unsigned short value, const FormatSpec& spec);
+template void formatstring::format_integer<char,unsigned int>(Writer& out, unsigned int value, const FormatSpec& spec);
+template void formatstring::format_integer<char,unsigned long>(Writer& out, unsigned long value, const FormatSpec& spec);
+template void formatstring::format_integer<char,unsigned long long>(Writer& out, unsigned long long value, const FormatSpec& spec);
 
-template void format_int_char<char16_t>(std::basic_ostream<char16_t>& out, std::char_traits<char16_t>::int_type value, const U16FormatSpec& spec);
-template void format_string<char16_t>(std::basic_ostream<char16_t>& out, const char16_t value[], const U16FormatSpec& spec);
+template void formatstring::format_integer<wchar_t,wchar_t>(WWriter& out, wchar_t value, const WFormatSpec& spec);
 
-template void format_float<char16_t,float>(std::basic_ostream<char16_t>& out, float value, const U16FormatSpec& spec);
-template void format_float<char16_t,double>(std::basic_ostream<char16_t>& out, double value, const U16FormatSpec& spec);
-template void format_float<char16_t,long double>(std::basic_ostream<char16_t>& out, long double value, const U16FormatSpec& spec);
+template void formatstring::format_integer<wchar_t,char>(WWriter& out, char value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,short>(WWriter& out, short value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,int>(WWriter& out, int value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,long>(WWriter& out, long value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,long long>(WWriter& out, long long value, const WFormatSpec& spec);
 
-template void format_integer<char16_t,char16_t>(std::basic_ostream<char16_t>& out, char16_t value, const U16FormatSpec& spec);
+template void formatstring::format_integer<wchar_t,signed char>(WWriter& out, signed char value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,unsigned char>(WWriter& out, unsigned char value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,unsigned short>(WWriter& out, unsigned short value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,unsigned int>(WWriter& out, unsigned int value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,unsigned long>(WWriter& out, unsigned long value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,unsigned long long>(WWriter& out, unsigned long long value, const WFormatSpec& spec);
 
-template void format_integer<char16_t,char>(std::basic_ostream<char16_t>& out, char value, const U16FormatSpec& spec);
-template void format_integer<char16_t,short>(std::basic_ostream<char16_t>& out, short value, const U16FormatSpec& spec);
-template void format_integer<char16_t,int>(std::basic_ostream<char16_t>& out, int value, const U16FormatSpec& spec);
-template void format_integer<char16_t,long>(std::basic_ostream<char16_t>& out, long value, const U16FormatSpec& spec);
-template void format_integer<char16_t,long long>(std::basic_ostream<char16_t>& out, long long value, const U16FormatSpec& spec);
+#ifdef FORMATSTRING_INT128_SUPPORT
+template void formatstring::format_integer<char,int128,uint128>(Writer& out, int128 value, const FormatSpec& spec);
+template void formatstring::format_integer<char,uint128,uint128>(Writer& out, uint128 value, const FormatSpec& spec);
 
-template void format_integer<char16_t,signed char>(std::basic_ostream<char16_t>& out, signed char value, const U16FormatSpec& spec);
-template void format_integer<char16_t,unsigned char>(std::basic_ostream<char16_t>& out, unsigned char value, const U16FormatSpec& spec);
-template void format_integer<char16_t,unsigned short>(std::basic_ostream<char16_t>& out, unsigned short value, const U16FormatSpec& spec);
-template void format_integer<char16_t,unsigned int>(std::basic_ostream<char16_t>& out, unsigned int value, const U16FormatSpec& spec);
-template void format_integer<char16_t,unsigned long>(std::basic_ostream<char16_t>& out, unsigned long value, const U16FormatSpec& spec);
-template void format_integer<char16_t,unsigned long long>(std::basic_ostream<char16_t>& out, unsigned long long value, const U16FormatSpec& spec);
-
-const std::locale impl::basic_grouping<char16_t>::non_grouping_locale(std::locale(), new no_grouping<char16_t>());
-const std::locale impl::basic_grouping<char16_t>::thousands_grouping_locale(std::locale(), new group_thousands<char16_t>());
+template void formatstring::format_integer<wchar_t,int128,uint128>(WWriter& out, int128 value, const WFormatSpec& spec);
+template void formatstring::format_integer<wchar_t,uint128,uint128>(WWriter& out, uint128 value, const WFormatSpec& spec);
 #endif
 
-#ifdef FORMATSTRING_CHAR32_SUPPORT
-template void repr_bool<char32_t>(std::basic_ostream<char32_t>& out, bool value);
-template void repr_char<char32_t>(std::basic_ostream<char32_t>& out, char32_t value);
-template void repr_string<char32_t>(std::basic_stream<char32_t>& out, const char32_t* value);
-
-template void format_bool<char32_t>(std::basic_stream<char32_t>& out, bool value, const U32FormatSpec& spec);
+template void formatstring::format_each<char,short>(Writer& out, const short* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,int>(Writer& out, const int* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,long>(Writer& out, const long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,long long>(Writer& out, const long long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,unsigned short>(Writer& out, const unsigned short* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,unsigned int>(Writer& out, const unsigned int* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,unsigned long>(Writer& out, const unsigned long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,unsigned long long>(Writer& out, const unsigned long long* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,float>(Writer& out, const float* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,double>(Writer& out, const double* values, std::size_t count, const FormatSpec& spec, const char* separator);
+template void formatstring::format_each<char,long double>(Writer& out, const long double* values, std::size_t count, const FormatSpec& spec, const char* separator);
+
+template void formatstring::format_each<wchar_t,short>(WWriter& out, const short* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,int>(WWriter& out, const int* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,long>(WWriter& out, const long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,long long>(WWriter& out, const long long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,unsigned short>(WWriter& out, const unsigned short* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,unsigned int>(WWriter& out, const unsigned int* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,unsigned long>(WWriter& out, const unsigned long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,unsigned long long>(WWriter& out, const unsigned long long* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,float>(WWriter& out, const float* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,double>(WWriter& out, const double* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
+template void formatstring::format_each<wchar_t,long double>(WWriter& out, const long double* values, std::size_t count, const WFormatSpec& spec, const wchar_t* separator);
 
-template void format_int_char<char32_t>(std::basic_ostream<char32_t>& out, std::char_traits<char32_t>::int_type value, const U32FormatSpec& spec);
-template void format_string<char32_t>(std::basic_ostream<char32_t>& out, const char32_t value[], const U32FormatSpec& spec);
 
-template void format_float<char32_t,float>(std::basic_ostream<char32_t>& out, float value, const U32FormatSpec& spec);
-template void format_float<char32_t,double>(std::basic_ostream<char32_t>& out, double value, const U32FormatSpec& spec);
-template void format_float<char32_t,long double>(std::basic_ostream<char32_t>& out, long double value, const U32FormatSpec& spec);
-
-template void format_integer<char32_t,char32_t>(std::basic_ostream<char32_t>& out, char32_t value, const U32FormatSpec& spec);
-
-template void format_integer<char32_t,char>(std::basic_ostream<char16_t>& out, char value, const U32FormatSpec& spec);
-template void format_integer<char32_t,short>(std::basic_ostream<char32_t>& out, short value, const U32FormatSpec& spec);
-template void format_integer<char32_t,int>(std::basic_ostream<char32_t>& out, int value, const U32FormatSpec& spec);
-template void format_integer<char32_t,long>(std::basic_ostream<char32_t>& out, long value, const U32FormatSpec& spec);
-template void format_integer<char32_t,long long>(std::basic_ostream<char32_t>& out, long long value, const U32FormatSpec& spec);
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+template void formatstring::repr_bool<char16_t>(BasicWriter<char16_t>& out, bool value);
+template void formatstring::repr_char<char16_t>(BasicWriter<char16_t>& out, char16_t value);
+template void formatstring::repr_string<char16_t>(BasicWriter<char16_t>& out, const char16_t* value);
+template void formatstring::repr_string<char16_t>(BasicWriter<char16_t>& out, const char16_t* value, std::size_t length);
+
+template void formatstring::format_bool<char16_t>(BasicWriter<char16_t>& out, bool value, const U16FormatSpec& spec);
+
+template void formatstring::format_int_char<char16_t>(BasicWriter<char16_t>& out, std::char_traits<char16_t>::int_type value, const U16FormatSpec& spec);
+template void formatstring::format_string<char16_t>(BasicWriter<char16_t>& out, const char16_t value[], const U16FormatSpec& spec);
+template void formatstring::format_string<char16_t>(BasicWriter<char16_t>& out, const char16_t value[], std::size_t length, const U16FormatSpec& spec);
+template void formatstring::check_string_spec<char16_t>(const U16FormatSpec& spec);
+template void formatstring::check_float_spec<char16_t>(const U16FormatSpec& spec);
+
+template void formatstring::repr_float<char16_t,float>(BasicWriter<char16_t>& out, float value);
+template void formatstring::repr_float<char16_t,double>(BasicWriter<char16_t>& out, double value);
+template void formatstring::repr_float<char16_t,long double>(BasicWriter<char16_t>& out, long double value);
+
+template void formatstring::format_float<char16_t,float>(BasicWriter<char16_t>& out, float value, const U16FormatSpec& spec);
+template void formatstring::format_float<char16_t,double>(BasicWriter<char16_t>& out, double value, const U16FormatSpec& spec);
+template void formatstring::format_float<char16_t,long double>(BasicWriter<char16_t>& out, long double value, const U16FormatSpec& spec);
+
+template void formatstring::format_integer<char16_t,char16_t>(BasicWriter<char16_t>& out, char16_t value, const U16FormatSpec& spec);
+
+template void formatstring::format_integer<char16_t,char>(BasicWriter<char16_t>& out, char value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,short>(BasicWriter<char16_t>& out, short value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,int>(BasicWriter<char16_t>& out, int value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,long>(BasicWriter<char16_t>& out, long value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,long long>(BasicWriter<char16_t>& out, long long value, const U16FormatSpec& spec);
+
+template void formatstring::format_integer<char16_t,signed char>(BasicWriter<char16_t>& out, signed char value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,unsigned char>(BasicWriter<char16_t>& out, unsigned char value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,unsigned short>(BasicWriter<char16_t>& out, unsigned short value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,unsigned int>(BasicWriter<char16_t>& out, unsigned int value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,unsigned long>(BasicWriter<char16_t>& out, unsigned long value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,unsigned long long>(BasicWriter<char16_t>& out, unsigned long long value, const U16FormatSpec& spec);
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+template void formatstring::format_integer<char16_t,int128,uint128>(BasicWriter<char16_t>& out, int128 value, const U16FormatSpec& spec);
+template void formatstring::format_integer<char16_t,uint128,uint128>(BasicWriter<char16_t>& out, uint128 value, const U16FormatSpec& spec);
+#endif
 
-template void format_integer<char32_t,signed char>(std::basic_ostream<char32_t>& out, signed char value, const U32FormatSpec& spec);
-template void format_integer<char32_t,unsigned char>(std::basic_ostream<char32_t>& out, unsigned char value, const U32FormatSpec& spec);
-template void format_integer<char32_t,unsigned short>(std::basic_ostream<char32_t>& out, unsigned short value, const U32FormatSpec& spec);
-template void format_integer<char32_t,unsigned int>(std::basic_ostream<char32_t>& out, unsigned int value, const U32FormatSpec& spec);
-template void format_integer<char32_t,unsigned long>(std::basic_ostream<char32_t>& out, unsigned long value, const U32FormatSpec& spec);
-template void format_integer<char32_t,unsigned long long>(std::basic_ostream<char32_t>& out, unsigned long long value, const U32FormatSpec& spec);
+template void formatstring::format_each<char16_t,short>(BasicWriter<char16_t>& out, const short* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,int>(BasicWriter<char16_t>& out, const int* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,long>(BasicWriter<char16_t>& out, const long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,long long>(BasicWriter<char16_t>& out, const long long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,unsigned short>(BasicWriter<char16_t>& out, const unsigned short* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,unsigned int>(BasicWriter<char16_t>& out, const unsigned int* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,unsigned long>(BasicWriter<char16_t>& out, const unsigned long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,unsigned long long>(BasicWriter<char16_t>& out, const unsigned long long* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,float>(BasicWriter<char16_t>& out, const float* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,double>(BasicWriter<char16_t>& out, const double* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+template void formatstring::format_each<char16_t,long double>(BasicWriter<char16_t>& out, const long double* values, std::size_t count, const U16FormatSpec& spec, const char16_t* separator);
+#endif
 
-const std::locale impl::basic_grouping<char32_t>::non_grouping_locale(std::locale(), new no_grouping<char32_t>());
-const std::locale impl::basic_grouping<char32_t>::thousands_grouping_locale(std::locale(), new group_thousands<char32_t>());
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+template void formatstring::repr_bool<char32_t>(BasicWriter<char32_t>& out, bool value);
+template void formatstring::repr_char<char32_t>(BasicWriter<char32_t>& out, char32_t value);
+template void formatstring::repr_string<char32_t>(BasicWriter<char32_t>& out, const char32_t* value);
+template void formatstring::repr_string<char32_t>(BasicWriter<char32_t>& out, const char32_t* value, std::size_t length);
+
+template void formatstring::format_bool<char32_t>(BasicWriter<char32_t>& out, bool value, const U32FormatSpec& spec);
+
+template void formatstring::format_int_char<char32_t>(BasicWriter<char32_t>& out, std::char_traits<char32_t>::int_type value, const U32FormatSpec& spec);
+template void formatstring::format_string<char32_t>(BasicWriter<char32_t>& out, const char32_t value[], const U32FormatSpec& spec);
+template void formatstring::format_string<char32_t>(BasicWriter<char32_t>& out, const char32_t value[], std::size_t length, const U32FormatSpec& spec);
+template void formatstring::check_string_spec<char32_t>(const U32FormatSpec& spec);
+template void formatstring::check_float_spec<char32_t>(const U32FormatSpec& spec);
+
+template void formatstring::repr_float<char32_t,float>(BasicWriter<char32_t>& out, float value);
+template void formatstring::repr_float<char32_t,double>(BasicWriter<char32_t>& out, double value);
+template void formatstring::repr_float<char32_t,long double>(BasicWriter<char32_t>& out, long double value);
+
+template void formatstring::format_float<char32_t,float>(BasicWriter<char32_t>& out, float value, const U32FormatSpec& spec);
+template void formatstring::format_float<char32_t,double>(BasicWriter<char32_t>& out, double value, const U32FormatSpec& spec);
+template void formatstring::format_float<char32_t,long double>(BasicWriter<char32_t>& out, long double value, const U32FormatSpec& spec);
+
+template void formatstring::format_integer<char32_t,char32_t>(BasicWriter<char32_t>& out, char32_t value, const U32FormatSpec& spec);
+
+template void formatstring::format_integer<char32_t,char>(BasicWriter<char32_t>& out, char value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,short>(BasicWriter<char32_t>& out, short value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,int>(BasicWriter<char32_t>& out, int value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,long>(BasicWriter<char32_t>& out, long value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,long long>(BasicWriter<char32_t>& out, long long value, const U32FormatSpec& spec);
+
+template void formatstring::format_integer<char32_t,signed char>(BasicWriter<char32_t>& out, signed char value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,unsigned char>(BasicWriter<char32_t>& out, unsigned char value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,unsigned short>(BasicWriter<char32_t>& out, unsigned short value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,unsigned int>(BasicWriter<char32_t>& out, unsigned int value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,unsigned long>(BasicWriter<char32_t>& out, unsigned long value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,unsigned long long>(BasicWriter<char32_t>& out, unsigned long long value, const U32FormatSpec& spec);
+
+#ifdef FORMATSTRING_INT128_SUPPORT
+template void formatstring::format_integer<char32_t,int128,uint128>(BasicWriter<char32_t>& out, int128 value, const U32FormatSpec& spec);
+template void formatstring::format_integer<char32_t,uint128,uint128>(BasicWriter<char32_t>& out, uint128 value, const U32FormatSpec& spec);
 #endif
 
-const std::locale impl::basic_grouping<wchar_t>::non_grouping_locale(std::locale(), new no_grouping<wchar_t>());
-const std::locale impl::basic_grouping<wchar_t>::thousands_grouping_locale(std::locale(), new group_thousands<wchar_t>());
+template void formatstring::format_each<char32_t,short>(BasicWriter<char32_t>& out, const short* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,int>(BasicWriter<char32_t>& out, const int* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,long>(BasicWriter<char32_t>& out, const long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,long long>(BasicWriter<char32_t>& out, const long long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,unsigned short>(BasicWriter<char32_t>& out, const unsigned short* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,unsigned int>(BasicWriter<char32_t>& out, const unsigned int* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,unsigned long>(BasicWriter<char32_t>& out, const unsigned long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,unsigned long long>(BasicWriter<char32_t>& out, const unsigned long long* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,float>(BasicWriter<char32_t>& out, const float* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,double>(BasicWriter<char32_t>& out, const double* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+template void formatstring::format_each<char32_t,long double>(BasicWriter<char32_t>& out, const long double* values, std::size_t count, const U32FormatSpec& spec, const char32_t* separator);
+#endif
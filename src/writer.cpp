@@ -0,0 +1,86 @@
+#include "formatstring/writer.h"
+
+#include <cerrno>
+
+#ifdef _WIN32
+#   include <io.h>
+#else
+#   include <unistd.h>
+#endif
+
+using namespace formatstring;
+
+FdWriter::~FdWriter() {
+    flush();
+}
+
+void FdWriter::flush() {
+    std::size_t count = m_pos - m_buffer;
+    if (count > 0) {
+        setbuf(m_buffer, m_buffer + BUFFER_SIZE);
+        write_fd(m_buffer, count);
+    }
+}
+
+void FdWriter::overflow(const char* str, std::size_t count) {
+    flush();
+    if (count < BUFFER_SIZE) {
+        std::char_traits<char>::copy(m_pos, str, count);
+        m_pos += count;
+    }
+    else {
+        m_count += count;
+        write_fd(str, count);
+    }
+}
+
+void FdWriter::write_fd(const char* str, std::size_t count) {
+    while (count > 0 && m_error == 0) {
+#ifdef _WIN32
+        int written = ::_write(m_fd, str, count > 0x7fffffff ? 0x7fffffff : (unsigned int)count);
+#else
+        ssize_t written = ::write(m_fd, str, count);
+#endif
+        if (written < 0) {
+            if (errno != EINTR) {
+                m_error = errno;
+            }
+        }
+        else {
+            str   += written;
+            count -= written;
+        }
+    }
+}
+
+template class formatstring::BasicWriter<char>;
+template class formatstring::BasicOStreamWriter<char>;
+template class formatstring::BasicBufferWriter<char>;
+template class formatstring::BasicPointerWriter<char>;
+template class formatstring::BasicStringWriter<char>;
+template class formatstring::BasicCountingWriter<char>;
+
+#ifdef FORMATSTRING_CHAR16_SUPPORT
+template class formatstring::BasicWriter<char16_t>;
+template class formatstring::BasicOStreamWriter<char16_t>;
+template class formatstring::BasicBufferWriter<char16_t>;
+template class formatstring::BasicPointerWriter<char16_t>;
+template class formatstring::BasicStringWriter<char16_t>;
+template class formatstring::BasicCountingWriter<char16_t>;
+#endif
+
+#ifdef FORMATSTRING_CHAR32_SUPPORT
+template class formatstring::BasicWriter<char32_t>;
+template class formatstring::BasicOStreamWriter<char32_t>;
+template class formatstring::BasicBufferWriter<char32_t>;
+template class formatstring::BasicPointerWriter<char32_t>;
+template class formatstring::BasicStringWriter<char32_t>;
+template class formatstring::BasicCountingWriter<char32_t>;
+#endif
+
+template class formatstring::BasicWriter<wchar_t>;
+template class formatstring::BasicOStreamWriter<wchar_t>;
+template class formatstring::BasicBufferWriter<wchar_t>;
+template class formatstring::BasicPointerWriter<wchar_t>;
+template class formatstring::BasicStringWriter<wchar_t>;
+template class formatstring::BasicCountingWriter<wchar_t>;
@@ -89,15 +89,84 @@ private:
     signed char value;
 };
 
+// only formattable through operator<<
+class Streamed {
+public:
+    inline Streamed(const std::string& value) : value(value) {}
+
+    std::string value;
+};
+
+std::ostream& operator<<(std::ostream& out, const Streamed& streamed) {
+    return out << '<' << streamed.value << '>';
+}
+
+// formats a fallback value inside operator<<
+class Nested {
+public:
+    inline Nested(const std::string& value) : value(value) {}
+
+    std::string value;
+};
+
+std::ostream& operator<<(std::ostream& out, const Nested& nested) {
+    return out << format("{:_^10}", Streamed(nested.value));
+}
+
+// has its own format spec mini-language
+class Word {
+public:
+    inline Word(const std::string& value) : value(value) {}
+
+    std::string value;
+};
+
+namespace formatstring {
+    // The custom spec is a sequence of U (upper case), L (lower case) and R (reverse).
+    template<>
+    struct formatter<Word> {
+        std::string actions;
+
+        void parse(const char* begin, const char* end) {
+            for (const char* ptr = begin; ptr != end; ++ ptr) {
+                if (*ptr != 'U' && *ptr != 'L' && *ptr != 'R') {
+                    throw std::invalid_argument("illegal word format spec");
+                }
+            }
+            actions.assign(begin, end);
+        }
+
+        void format(Writer& out, const Word& word) const {
+            std::string value = word.value;
+            for (char action : actions) {
+                switch (action) {
+                case 'U':
+                    std::transform(value.begin(), value.end(), value.begin(), [](char ch) { return std::toupper(ch); });
+                    break;
+
+                case 'L':
+                    std::transform(value.begin(), value.end(), value.begin(), [](char ch) { return std::tolower(ch); });
+                    break;
+
+                case 'R':
+                    std::reverse(value.begin(), value.end());
+                    break;
+                }
+            }
+            out.write(value.data(), value.size());
+        }
+    };
+}
+
 // trim from start
 static inline std::string &ltrim(std::string &s) {
-        s.erase(s.begin(), std::find_if(s.begin(), s.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+        s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](int ch) { return !std::isspace(ch); }));
         return s;
 }
 
 // trim from end
 static inline std::string &rtrim(std::string &s) {
-        s.erase(std::find_if(s.rbegin(), s.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
+        s.erase(std::find_if(s.rbegin(), s.rend(), [](int ch) { return !std::isspace(ch); }).base(), s.end());
         return s;
 }
 
@@ -231,6 +300,220 @@ std::string lexical_cast(const char* str) {
     return str;
 }
 
+#ifdef FORMATSTRING_INT128_SUPPORT
+// std::istream can't read 128 bit integers
+template<typename Int, typename UInt>
+Int int128_lexical_cast(const char* str) {
+    const char* ptr = str;
+    bool negative = *ptr == '-';
+    if (negative || *ptr == '+') {
+        ++ ptr;
+    }
+    if (!*ptr) {
+        throw std::invalid_argument(str);
+    }
+    UInt val = 0;
+    for (; *ptr; ++ ptr) {
+        if (*ptr < '0' || *ptr > '9') {
+            throw std::invalid_argument(str);
+        }
+        val = val * 10 + (*ptr - '0');
+    }
+    return negative ? (Int)-val : (Int)val;
+}
+
+template<>
+int128 lexical_cast(const char* str) {
+    return int128_lexical_cast<int128,uint128>(str);
+}
+
+template<>
+uint128 lexical_cast(const char* str) {
+    return int128_lexical_cast<uint128,uint128>(str);
+}
+#endif
+
+// Options that test other entry points than format(fmt, value), for single values:
+//
+//   --to-n=N  format_to_n() into a buffer of N characters. Prints the returned length,
+//             ':' and the characters that were written.
+//   --size    Prints formatted_size(), after checking it against the size of the string.
+//   --typed   Formats with a typed format, BasicFormat<char,T>.
+//   --escaped String values may contain \0, \xHH and \\ escapes. char[] values end at
+//             the first null character, std::string and std::string_view values keep it.
+//   --cache   Formats from one buffer whose contents change, and checks the hits and
+//             misses of the format cache. Prints the results of the format string, the
+//             format string in brackets and the format string again, each formatted twice.
+//
+// And for arrays of numbers:
+//
+//   --each=SEP  format_each() with SEP as separator. The format argument is a format spec.
+struct Options {
+    long toN = -1;
+    bool size = false;
+    bool typed = false;
+    bool escaped = false;
+    bool cache = false;
+    const char* each = nullptr;
+};
+
+static Options options;
+
+int parse_options(int argc, const char* argv[]) {
+    int index = 1;
+    for (; index < argc && std::strncmp(argv[index], "--", 2) == 0; ++ index) {
+        const char* arg = argv[index];
+        if (std::strncmp(arg, "--to-n=", 7) == 0) {
+            options.toN = lexical_cast<long>(arg + 7);
+            if (options.toN < 0) {
+                throw std::invalid_argument(arg);
+            }
+        }
+        else if (std::strcmp(arg, "--size") == 0) {
+            options.size = true;
+        }
+        else if (std::strcmp(arg, "--typed") == 0) {
+            options.typed = true;
+        }
+        else if (std::strcmp(arg, "--escaped") == 0) {
+            options.escaped = true;
+        }
+        else if (std::strcmp(arg, "--cache") == 0) {
+            options.cache = true;
+        }
+        else if (std::strncmp(arg, "--each=", 7) == 0) {
+            options.each = arg + 7;
+        }
+        else {
+            throw std::invalid_argument(arg);
+        }
+    }
+    return index;
+}
+
+int hex_digit(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    else if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    else if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    else {
+        return -1;
+    }
+}
+
+std::string parse_string(const char* str) {
+    if (!options.escaped) {
+        return str;
+    }
+    std::string value;
+    for (const char* ptr = str; *ptr; ++ ptr) {
+        if (*ptr != '\\') {
+            value += *ptr;
+        }
+        else if (ptr[1] == '0') {
+            value += '\0';
+            ++ ptr;
+        }
+        else if (ptr[1] == '\\') {
+            value += '\\';
+            ++ ptr;
+        }
+        else if (ptr[1] == 'x' && hex_digit(ptr[2]) >= 0 && hex_digit(ptr[3]) >= 0) {
+            value += (char)(hex_digit(ptr[2]) * 16 + hex_digit(ptr[3]));
+            ptr += 3;
+        }
+        else {
+            throw std::invalid_argument(str);
+        }
+    }
+    return value;
+}
+
+enum CacheLookup {
+    Hit,
+    Miss,
+    HitOrMiss
+};
+
+template<typename T>
+void format_cached(const char* fmt, const T& value, CacheLookup lookup) {
+    const std::size_t hits   = FormatCache::hits();
+    const std::size_t misses = FormatCache::misses();
+
+    std::cout << format(fmt, value) << '\n';
+
+    const std::size_t newHits   = FormatCache::hits() - hits;
+    const std::size_t newMisses = FormatCache::misses() - misses;
+    if (newHits + newMisses != 1 || (lookup == Hit && newHits != 1) || (lookup == Miss && newMisses != 1)) {
+        throw std::runtime_error("unexpected format cache hits/misses");
+    }
+}
+
+template<typename T>
+void output(const char* fmt, const T& value) {
+    if (options.toN >= 0) {
+        // guard characters behind the buffer catch writes past n
+        const std::size_t n = options.toN;
+        const std::size_t GUARD_SIZE = 16;
+        std::string buf(n + GUARD_SIZE, '\x7f');
+        const std::size_t len = format_to_n(&buf[0], n, fmt, value);
+        if (buf.compare(n, GUARD_SIZE, std::string(GUARD_SIZE, '\x7f')) != 0) {
+            throw std::runtime_error("format_to_n() wrote past the end of the buffer");
+        }
+        std::cout << len << ':';
+        std::cout.write(buf.data(), std::min(len, n));
+    }
+    else if (options.size) {
+        const std::size_t size = formatted_size(fmt, value);
+        if (format(fmt, value).formatted_size() != size || format(fmt, value).str().size() != size) {
+            throw std::runtime_error("formatted_size() doesn't match the formatted string");
+        }
+        std::cout << size;
+    }
+    else if (options.typed) {
+        BasicFormat<char,T>(fmt).format(std::cout, value);
+    }
+    else if (options.cache) {
+        const std::string plain = fmt;
+        const std::string bracketed = "[" + plain + "]";
+        std::vector<char> buf(bracketed.size() + 1);
+
+        std::copy(plain.c_str(), plain.c_str() + plain.size() + 1, buf.begin());
+        format_cached(buf.data(), value, Miss);
+        format_cached(buf.data(), value, Hit);
+
+        // same address, new contents
+        std::copy(bracketed.c_str(), bracketed.c_str() + bracketed.size() + 1, buf.begin());
+        format_cached(buf.data(), value, Miss);
+        format_cached(buf.data(), value, Hit);
+
+        // still in the shared table, unless the bracketed string evicted it
+        std::copy(plain.c_str(), plain.c_str() + plain.size() + 1, buf.begin());
+        format_cached(buf.data(), value, HitOrMiss);
+        format_cached(buf.data(), value, Hit);
+    }
+    else {
+        std::cout << format(fmt, value);
+    }
+}
+
+template<typename T>
+void output_each(const char* spec, const T* values, std::size_t count, std::true_type) {
+    OStreamWriter out(std::cout);
+    format_each(out, values, count, FormatSpec(spec), options.each);
+    out.flush();
+}
+
+template<typename T>
+void output_each(const char*, const T*, std::size_t, std::false_type) {
+    throw std::invalid_argument("--each needs an array of numbers");
+}
+
 template<typename T>
 void format_vector(const char* fmt, const std::size_t n, const char* values[]) {
     std::vector<T> vec;
@@ -264,7 +547,17 @@ enum ValueType {
     UInt16,
     UInt32,
     UInt64,
-    String
+#ifdef FORMATSTRING_INT128_SUPPORT
+    Int128,
+    UInt128,
+#endif
+    String,
+    StreamedString,
+    NestedString,
+    WordString,
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    StringView
+#endif
 };
 
 ValueType parse_value_type(const std::string& type) {
@@ -337,9 +630,31 @@ ValueType parse_value_type(const std::string& type) {
     else if (type == "uint64_t") {
         return UInt64;
     }
+#ifdef FORMATSTRING_INT128_SUPPORT
+    else if (type == "__int128") {
+        return Int128;
+    }
+    else if (type == "unsigned __int128") {
+        return UInt128;
+    }
+#endif
     else if (type == "string") {
         return String;
     }
+    else if (type == "streamed") {
+        return StreamedString;
+    }
+    else if (type == "nested") {
+        return NestedString;
+    }
+    else if (type == "word") {
+        return WordString;
+    }
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+    else if (type == "string_view") {
+        return StringView;
+    }
+#endif
     else {
         throw std::invalid_argument(type);
     }
@@ -347,7 +662,19 @@ ValueType parse_value_type(const std::string& type) {
 
 template<typename ParseType, typename UseType = ParseType>
 void do_format_value(const char* fmt, const char* value) {
-    std::cout << format(fmt, (UseType)lexical_cast<ParseType>(value));
+    output(fmt, (UseType)lexical_cast<ParseType>(value));
+}
+
+template<typename String>
+void do_format_string(const char* fmt, const char* value) {
+    const std::string str = parse_string(value);
+    output(fmt, String(str));
+}
+
+template<>
+void do_format_string<const char*>(const char* fmt, const char* value) {
+    const std::string str = parse_string(value);
+    output(fmt, str.c_str());
 }
 
 template<typename Collection, typename T>
@@ -397,7 +724,12 @@ void do_format_array(const char* fmt, std::size_t argc, const char* argv[]) {
         for (std::size_t i = 0; i < argc; ++ i) {
             array[i] = lexical_cast<ParseType>(argv[i]);
         }
-        std::cout << format(fmt, slice(array, array + argc));
+        if (options.each) {
+            output_each(fmt, array, argc, impl::is_plain_number<UseType>());
+        }
+        else {
+            std::cout << format(fmt, slice(array, array + argc));
+        }
         delete[] array;
         array = 0;
     }
@@ -606,7 +938,17 @@ void do_format(const char* fmt, const std::string& type, std::size_t argc, const
         case UInt16:     do_format_value<std::uint16_t>(fmt, argv[0]); break;
         case UInt32:     do_format_value<std::uint32_t>(fmt, argv[0]); break;
         case UInt64:     do_format_value<std::uint64_t>(fmt, argv[0]); break;
-        case String:     do_format_value<std::string>(fmt, argv[0]); break;
+#ifdef FORMATSTRING_INT128_SUPPORT
+        case Int128:     do_format_value<int128>(fmt, argv[0]); break;
+        case UInt128:    do_format_value<uint128>(fmt, argv[0]); break;
+#endif
+        case String:     do_format_string<std::string>(fmt, argv[0]); break;
+        case StreamedString: do_format_string<Streamed>(fmt, argv[0]); break;
+        case NestedString:   do_format_string<Nested>(fmt, argv[0]); break;
+        case WordString:     do_format_string<Word>(fmt, argv[0]); break;
+#ifdef FORMATSTRING_STRING_VIEW_SUPPORT
+        case StringView: do_format_string<std::string_view>(fmt, argv[0]); break;
+#endif
         default: throw std::runtime_error("unhandeled type");
         }
     }
@@ -619,7 +961,7 @@ void do_format(const char* fmt, const std::string& type, std::size_t argc, const
             if (argc != 1) {
                 throw std::range_error("illegal number of arguments");
             }
-            do_format_value<const char*>(fmt, argv[0]);
+            do_format_string<const char*>(fmt, argv[0]);
             break;
         case Short:      do_format_array<short>(fmt, argc, argv); break;
         case Int:        do_format_array<int>(fmt, argc, argv); break;
@@ -702,20 +1044,20 @@ void do_format(const char* fmt, const std::string& type, std::size_t argc, const
 }
 
 void usage(int argc, const char* argv[]) {
-    std::cout << "usage: " << (argc > 0 ? argv[0] : "format") << " <format> <type> <value>...\n";
+    std::cout << "usage: " << (argc > 0 ? argv[0] : "format") << " [options] <format> <type> <value>...\n";
 }
 
 int main(int argc, const char* argv[]) {
-    const char* fmt = argv[1];
+    try {
+        const int index = parse_options(argc, argv);
 
-    if (argc < 3) {
-        std::cerr << "illegal number of arguments\n";
-        usage(argc, argv);
-        return 1;
-    }
+        if (argc - index < 2) {
+            std::cerr << "illegal number of arguments\n";
+            usage(argc, argv);
+            return 1;
+        }
 
-    try {
-        do_format(fmt, argv[2], argc - 3, argv + 3);
+        do_format(argv[index], argv[index + 1], argc - index - 2, argv + index + 2);
     }
     catch (const std::invalid_argument& exc) {
         std::cerr << "invalid argument: " << exc.what() << '\n';
@@ -1,7 +1,10 @@
 #!/usr/bin/env python
 
+import os
 import sys
 import re
+from decimal import Decimal
+from fractions import Fraction
 from subprocess import Popen, PIPE
 from ctypes import c_uint8
 
@@ -20,6 +23,7 @@ STR_REPR = {
 }
 
 HAS_REPR = re.compile(r'{\d*!r[^}]*}')
+PERCENT_PREC = re.compile(r'{\d*:[^}]*?(?:\.(\d+))?%}')
 
 def crepr(val):
 	t = type(val)
@@ -76,6 +80,9 @@ uint16_values = uint8_values + [100, 1000, 0xffff]
 uint32_values = uint16_values + [0xffffffff]
 uint64_values = uint32_values + [0xffffffffffffffff]
 
+int128_values  = [-0x7fffffffffffffffffffffffffffffff, -10**20, -0x10000000000000000] + int64_values + [0x10000000000000000, 10**20, 10**38, 0x7fffffffffffffffffffffffffffffff]
+uint128_values = uint64_values + [0x10000000000000000, 10**19, 10**20, 10**38, 0xffffffffffffffffffffffffffffffff]
+
 float_values = [
 	-65535.0, -1234.5, -1000.0, -100.0, -1.0, -0.0, 0.0, 1.0, 100.0, 1000.0, 1234.5, 65535.0,
 	float('nan'), -float('nan'), float('-inf'), float('inf')]
@@ -92,7 +99,7 @@ aligns = ['', '_<', '_>', '_=', '_^']
 signs  = ['', '+', '-', ' ']
 alts   = ['', '#']
 widths = ['', '0', '01', '016']
-tdssep = ['', ',']
+tdssep = ['', ',', '_']
 precs  = ['', '.0', '.1', '.6', '.12']
 
 str_aligns = ['_<', '_>', '_^']
@@ -104,9 +111,10 @@ str_aligns = ['_<', '_>', '_^']
 #str_types   = ['s', 'S']
 char_types   = []
 nondec_types = ['b', 'o', 'x']
+# Python only allows '_' with these (groups of four digits)
+nondec_tdssep = ['_']
 int_types    = nondec_types + ['d']
-# XXX: g and G isn't fully supported yet (trailing zeros aren't truncated)
-float_types  = ['e', 'E', 'f', 'F', '%']
+float_types  = ['e', 'E', 'f', 'F', 'g', 'G', '%']
 str_types    = ['s']
 all_types    = char_types + int_types + float_types + str_types
 
@@ -117,6 +125,8 @@ bool_specs = \
 int_specs = \
 	list(comb(convs, (':'+spec for spec in
 		combs(aligns, signs, alts, widths, [''] + nondec_types)))) + \
+	list(comb(convs, (':'+spec for spec in
+		combs(aligns, signs, alts, widths, nondec_tdssep, nondec_types)))) + \
 	list(comb(convs, (':'+spec for spec in
 		combs(aligns, signs, alts, widths, tdssep, ['', 'd'])))) + \
 	list(comb(convs, (':'+spec for spec in
@@ -125,18 +135,18 @@ int_specs = \
 char_specs = \
 	list(comb(convs, (':'+spec for spec in
 		combs(aligns, signs, alts, widths, [''] + nondec_types)))) + \
+	list(comb(convs, (':'+spec for spec in
+		combs(aligns, signs, alts, widths, nondec_tdssep, nondec_types)))) + \
 	list(comb(convs, (':'+spec for spec in
 		combs(aligns, signs, alts, widths, tdssep, ['', 'd'])))) + \
 	list(comb(convs, (':'+spec for spec in
 		combs(aligns, signs, widths, tdssep, [''] + float_types))))
 
-#float_specs = \
-#	list(comb(convs, (':'+spec for spec in
-#		combs(aligns, signs, widths, tdssep, [''] + float_types))))
-
 float_specs = \
 	list(comb(convs, (':'+spec for spec in
-		combs(aligns, signs, widths, tdssep, float_types))))
+		combs(aligns, signs, widths, tdssep, [''] + float_types)))) + \
+	list(comb(convs, (':'+spec for spec in
+		combs(['', '_^'], ['', '+'], alts, ['', '016'], ['', ','], precs, ['', 'g', 'G']))))
 
 str_specs = \
 	list(comb(convs, (':'+spec for spec in
@@ -148,8 +158,7 @@ basic_formats = ['{}', '{!r}', '{!s}', '{0}', 'foo {0} bar {0} baz']
 bool_formats  = basic_formats + ['{%s}' % spec for spec in bool_specs]
 char_formats  = basic_formats + ['{%s}' % spec for spec in char_specs]
 int_formats   = basic_formats + ['{%s}' % spec for spec in int_specs]
-#float_formats = basic_formats + ['{%s}' % spec for spec in float_specs]
-float_formats = ['{%s}' % spec for spec in float_specs]
+float_formats = basic_formats + ['{%s}' % spec for spec in float_specs]
 str_formats   = basic_formats + ['{%s}' % spec for spec in str_specs]
 
 testcases = [
@@ -167,6 +176,9 @@ testcases = [
 	('std::uint32_t', uint32_values, int_formats),
 	('std::uint64_t', uint64_values, int_formats),
 
+	('__int128', int128_values, int_formats),
+	('unsigned __int128', uint128_values, int_formats),
+
 	('float', float_values, float_formats),
 	('double', double_values, float_formats),
 	('long double', long_double_values, float_formats),
@@ -175,7 +187,18 @@ testcases = [
 	('std::string', str_values, str_formats)
 ]
 
-def run_test(binary,tp,fmt,value):
+def percent_differs(fmt,value):
+	m = PERCENT_PREC.search(fmt)
+	if m is None or value != value or abs(value) == float('inf'):
+		return False
+	prec = int(m.group(1) or 6)
+	return '%.*f' % (prec, float(value) * 100) != format(Decimal(float(value)).scaleb(2), '.%df' % prec)
+
+failed = 0
+
+# The value as command line argument and the expected result, which is None if Python
+# formats it differently on purpose.
+def expected_result(tp,fmt,value):
 	pytp    = type(value)
 	is_str  = pytp is str
 	is_repr = HAS_REPR.search(fmt) is not None
@@ -203,19 +226,538 @@ def run_test(binary,tp,fmt,value):
 	if is_str and is_repr:
 		pyres = pyres.replace("'",'"')
 
+	# formatstring scales percentages exactly, Python rounds value * 100 to a float first
+	if not is_str and percent_differs(fmt, value):
+		pyres = None
+
+	return svalue, pyres
+
+def run_binary(binary,args,env=None):
+	pipe = Popen([binary] + args, stdout=PIPE, stderr=PIPE, env=env)
+	out, err = pipe.communicate()
+	return pipe.returncode, out.decode('latin1'), err.decode('utf-8')
+
+def report(ok,what,message):
+	global failed
+	if ok:
+		sys.stdout.write("[  OK  ] %s: %s\n" % (what, message))
+	else:
+		failed += 1
+		sys.stdout.write("[ FAIL ] %s: %s\n" % (what, message))
+
+def run_test(binary,tp,fmt,value):
+	svalue, pyres = expected_result(tp, fmt, value)
+	if pyres is None:
+		return
+
 #	sys.stdout.write("         %r: %r == ...\n" % (value, pyres))
-	pipe = Popen([binary, fmt, tp, svalue], stdout=PIPE, stderr=PIPE)
-	if pipe.wait() == 0:
-		cppres = pipe.stdout.read().decode('latin1')
+	status, cppres, error = run_binary(binary, [fmt, tp, svalue])
+	what = "%s %r.format(%r)" % (tp, fmt, value)
+	if status == 0:
 		if pyres == cppres:
-			sys.stdout.write("[  OK  ] %s %r.format(%r): %s == %s\n" % (tp, fmt, value, pyres, cppres))
+			report(True, what, "%s == %s" % (pyres, cppres))
+		else:
+			report(False, what, "%s != %s" % (pyres, cppres))
+	else:
+		report(False, what, error)
+
+# Runs the test binary with options. expected is the output, or None if it has to fail.
+# simd selects the vector instructions the library may use.
+def check(binary,options,fmt,tp,values,expected,simd=None):
+	env = dict(os.environ, FORMATSTRING_SIMD=simd) if simd else None
+	status, cppres, error = run_binary(binary, options + [fmt, tp] + values, env)
+	what = "%s%s %s %r.format(%s)" % ('FORMATSTRING_SIMD=%s ' % simd if simd else '', ' '.join(options), tp, fmt, ', '.join(values))
+	if expected is None:
+		report(status != 0, what, "expected an error, got %r" % cppres if status == 0 else error.strip())
+	elif status != 0:
+		report(False, what, error)
+	else:
+		report(expected == cppres, what, "%r %s %r" % (expected, '==' if expected == cppres else '!=', cppres))
+
+# format_to_n() truncates to the buffer size and returns the untruncated length
+to_n_cases = [
+	('std::int32_t', '{:_^+12,}', [-0x7fffffff, 0, 1000]),
+	('double',       '{0:e} {0}', [-1234.56789, 0.0]),
+	('std::string',  'foo {0!r} bar {0:_>20}', str_values),
+]
+
+def run_to_n_tests(binary):
+	for tp, fmt, values in to_n_cases:
+		for value in values:
+			svalue, pyres = expected_result(tp, fmt, value)
+			for n in sorted(set([0, 1, len(pyres) // 2, len(pyres) - 1, len(pyres), len(pyres) + 1, 64])):
+				if n >= 0:
+					check(binary, ['--to-n=%d' % n], fmt, tp, [svalue], '%d:%s' % (len(pyres), pyres[:n]))
+	sys.stdout.write("\n")
+
+# formatted_size() without formatting
+size_cases = to_n_cases + [
+	('std::int64_t',  '{:_<+#30x}', [-0x7fffffffffffffff, 0]),
+	('double',        '{0:.12f} {0:%}', [-4294967295.0, 1.0]),
+	('long double',   '{:_^40g}',   [-1234.56789, float('inf')]),
+	('std::string',   '{!r:_^30}',  str_values),
+]
+
+def run_size_tests(binary):
+	for tp, fmt, values in size_cases:
+		for value in values:
+			svalue, pyres = expected_result(tp, fmt, value)
+			if pyres is not None:
+				check(binary, ['--size'], fmt, tp, [svalue], str(len(pyres)))
+	sys.stdout.write("\n")
+
+# a reused format string buffer never gets the parsed format of its old contents
+cache_cases = [
+	('std::int32_t', ['{}', '{:_>+10x}', 'foo {0} bar {0:,}'], [-23, 1000]),
+	('double',       ['{:.3f}', '{!r}'],                       [-1234.56789]),
+	('std::string',  ['{}', '{:_^9}', '{!r}'],                 str_values),
+]
+
+def run_cache_tests(binary):
+	for tp, formats, values in cache_cases:
+		for fmt in formats:
+			for value in values:
+				svalue, pyres = expected_result(tp, fmt, value)
+				check(binary, ['--cache'], fmt, tp, [svalue], ''.join('%s\n' % res for res in [pyres, pyres, '[%s]' % pyres, '[%s]' % pyres, pyres, pyres]))
+	for fmt in ['{', '{:x', '{0!x}', '{:5q}']:
+		check(binary, ['--cache'], fmt, 'int', ['1'], None)
+	sys.stdout.write("\n")
+
+# Deterministic values of all magnitudes, plus the extremes. Enough of them that the output
+# of format_each() fills several blocks.
+def number_block(bits,signed,count=300):
+	if signed:
+		values = [-(2**(bits - 1) - 1), 2**(bits - 1) - 1]
+		bits -= 1
+	else:
+		values = [0, 2**bits - 1]
+	x = 1
+	for i in range(count):
+		x = (x * 6364136223846793005 + 1442695040888963407) % 2**64
+		value = x % 2**(1 + i % bits)
+		values.append(-value if signed and i % 3 == 0 else value)
+	return values
+
+each_separators = ['', ', ', ';' * 7, '-' * 400]
+
+each_int_types = [
+	('short', 16, True), ('int', 32, True), ('long', 64, True), ('long long', 64, True),
+	('unsigned short', 16, False), ('unsigned int', 32, False), ('unsigned long', 64, False), ('unsigned long long', 64, False),
+]
+
+each_int_specs = ['', '+', ' ', ',', '_', '+,d', '-d', '_>12', '016,', '#x', '_^+#14b', 'o']
+
+# format_each() writes decimal integers into blocks and formats everything else value by value
+def run_each_int_tests(binary):
+	for tp, bits, signed in each_int_types:
+		values = number_block(bits, signed)
+		svalues = [str(value) for value in values]
+		for spec in each_int_specs:
+			for sep in each_separators:
+				check(binary, ['--each=' + sep], spec, tp + '[]', svalues, sep.join(format(value, spec) for value in values))
+	check(binary, ['--each=,'], '', 'std::string[]', ['a', 'b'], None)
+	sys.stdout.write("\n")
+
+# Dyadic values, so that they are exact in every floating point type, with a chunk of huge
+# numbers in between.
+def float_block(mant_bits,max_exp,huge,count=200):
+	values = [0.0, -0.0, float('inf'), -float('inf'), float('nan')]
+	x = 1
+	for i in range(count):
+		x = (x * 6364136223846793005 + 1442695040888963407) % 2**64
+		value = float(x % 2**(1 + i % mant_bits)) * 2.0**((x >> 32) % (2 * max_exp) - max_exp)
+		values.append(-value if i % 3 == 0 else value)
+	return values[:64] + huge + values[64 + len(huge):128] + values[64:64 + len(huge)] + values[128:]
+
+def exact_str(value):
+	if value != value:
+		return 'nan'
+	elif abs(value) == float('inf'):
+		return str(value)
+	else:
+		return str(Decimal(value))
+
+each_float_types = [
+	('float',       float_block(24, 30, [2.0**100, -1.5 * 2.0**90]), []),
+	('double',      float_block(53, 60, [2.0**1000, -1.5 * 2.0**900, 2.0**-1070]), ['', '_>20']),
+	('long double', float_block(53, 60, [2.0**1000, -1.5 * 2.0**900, 2.0**-1070]), []),
+]
+
+each_float_specs = ['e', '.12e', 'E', 'f', '.0f', '.3f', ',.2f', '+g', ' .10g', 'G', '%', '.1%', '.300f', '.280e', '_>24.9e', '016.3f']
+
+# format_each() converts chunks of floating point numbers into blocks. Huge fixed point
+# numbers and huge precisions are formatted value by value.
+def run_each_float_tests(binary):
+	for tp, values, extra_specs in each_float_types:
+		for spec in extra_specs + each_float_specs:
+			fmt = '{:%s}' % spec
+			spec_values = [value for value in values if not percent_differs(fmt, value)]
+			svalues = [exact_str(value) for value in spec_values]
+			for sep in each_separators:
+				check(binary, ['--each=' + sep], spec, tp + '[]', svalues, sep.join(format(value, spec) for value in spec_values))
+	sys.stdout.write("\n")
+
+# string arguments are passed with their length and may contain null characters
+nul_values = ['a\0b', '\0', '\0\0x\0', 'foo\0', '\0' * 20 + 'bar']
+nul_formats = [('', ''), ('', '_>10'), ('', '_^9'), ('', '_<30'), ('r', ''), ('r', '_<16'), ('r', '_^40'), ('s', '_>12')]
+
+def escape_arg(s):
+	return ''.join('\\\\' if c == '\\' else '\\0' if c == '\0' else '\\x%02x' % ord(c) if ord(c) >= 0x80 else c for c in s)
+
+def conv_result(conv,spec,value):
+	return format(cstr(value) if conv == 'r' else value, spec)
+
+def run_nul_tests(binary):
+	types = ['std::string', 'char[]']
+	if run_binary(binary, ['{}', 'string_view', 'x'])[0] == 0:
+		types.append('string_view')
+	else:
+		sys.stdout.write("[ SKIP ] string_view: test binary is not compiled as C++17\n")
+	for tp in types:
+		for conv, spec in nul_formats:
+			fmt = '{%s%s}' % ('!' + conv if conv else '', ':' + spec if spec else '')
+			for value in nul_values:
+				str_value = value.split('\0')[0] if tp == 'char[]' else value
+				check(binary, ['--escaped'], fmt, tp, [escape_arg(value)], conv_result(conv, spec, str_value))
+	sys.stdout.write("\n")
+
+# containers are padded as a whole
+def container_repr(tp,values):
+	def item(value):
+		if tp.endswith('<char>'):
+			return "'%s'" % value
+		elif type(value) is bool:
+			return 'true' if value else 'false'
+		elif type(value) is str:
+			return cstr(value)
 		else:
-			sys.stdout.write("[ FAIL ] %s %r.format(%r): %s != %s\n" % (tp, fmt, value, pyres, cppres))
-#			sys.exit(1)
+			return repr(value)
+	if tp.startswith('map<'):
+		return '{%s}' % ', '.join('%s: %s' % (item(k), item(v)) for k, v in sorted(values))
+	elif tp.startswith('set<') or tp.startswith('unordered_set<'):
+		return '{%s}' % ', '.join(item(value) for value in sorted(values))
 	else:
-		error = pipe.stderr.read().decode('utf-8')
-		sys.stdout.write("[ FAIL ] %s %r.format(%r): %s\n" % (tp, fmt, value, error))
-#		sys.exit(1)
+		return '[%s]' % ', '.join(item(value) for value in values)
+
+container_cases = [
+	('vector<int>',        [1, -2, 300]),
+	('vector<int>',        []),
+	('vector<int>',        list(range(-50, 150, 3))),
+	('list<string>',       ['a', 'b"c', '', 'foo bar']),
+	('set<double>',        [1.5, -2.0, 0.25]),
+	('unordered_set<int>', [42]),
+	('map<string,int>',    [('b', 2), ('a', 1)]),
+	('vector<bool>',       [True, False]),
+	('vector<char>',       ['a', 'b']),
+	('int[]',              [1, -2, 300]),
+	('double[]',           [1.5, -0.25, 1234.56789]),
+]
+
+container_formats = ['{}', '{:30}', '{:_<30}', '{:_>30}', '{:_^31}', '{:_^5}', '{:_>600}', '{!r:_>40}', '{!s:_^40}']
+
+def run_container_tests(binary):
+	for tp, values in container_cases:
+		args = [str(value) for value in (item for pair in values for item in pair)] if tp.startswith('map<') else \
+		       [repr(value) if type(value) is float else str(value) for value in values]
+		for fmt in container_formats:
+			check(binary, [], fmt, tp, args, fmt.replace('!r', '').replace('!s', '').format(container_repr(tp, values)))
+	sys.stdout.write("\n")
+
+# !r and !s convert the value into a string that is then padded
+conversion_cases = [
+	('int',          [-5, 0, 123456]),
+	('std::int64_t', [-0x7fffffffffffffff]),
+	('float',        [1.5, -float('inf')]),
+	('double',       [1234.56789, -0.0, 1e20, float('nan')]),
+	('bool',         [True, False]),
+	('char',         ['a', ' ']),
+	('std::string',  ['a"b', '', ' Foo\nBar']),
+	('char[]',       ['x', 'tab\there']),
+]
+
+# the format and the Python format of the !r and !s conversions (arguments 0 and 1)
+conversion_formats = [
+	('{!r:_>14}', '{0:_>14}'),
+	('{!s:_<14}', '{1:_<14}'),
+	('{!r:_^15}', '{0:_^15}'),
+	('{!s:_^1}',  '{1:_^1}'),
+	('{!r:20}',   '{0:20}'),
+	('{!s:20}',   '{1:20}'),
+	('{!r:_<50}', '{0:_<50}'),
+	('{0!r:_>14}|{0!s:_<14}|{0!r}', '{0:_>14}|{1:_<14}|{0}'),
+]
+
+def convert(tp,value,conv):
+	if type(value) is bool:
+		return 'true' if value else 'false'
+	elif conv == 's':
+		return str(value)
+	elif tp == 'char':
+		return "'%s'" % value
+	elif type(value) is str:
+		return cstr(value)
+	else:
+		return repr(value)
+
+def run_conversion_tests(binary):
+	for tp, values in conversion_cases:
+		for fmt, pyfmt in conversion_formats:
+			for value in values:
+				svalue = repr(value) if type(value) is float else str(value)
+				check(binary, [], fmt, tp, [svalue], pyfmt.format(convert(tp, value, 'r'), convert(tp, value, 's')))
+	sys.stdout.write("\n")
+
+# types that are only formattable through operator<<, printing '<value>'. nested formats
+# such a value inside its operator<<.
+fallback_values = ['abc', '', 'a b', 'x' * 5000]
+fallback_formats = ['{}', '{:20}', '{:_>20}', '{:_<20}', '{:_^21}', '{!r:_>20}', '{!s:_^3}', '{0:_>12}{0}', '{:_>6000}']
+
+def run_fallback_tests(binary):
+	for tp in ['streamed', 'nested']:
+		for value in fallback_values:
+			text = '<%s>' % value
+			if tp == 'nested':
+				text = format(text, '_^10')
+			for fmt in fallback_formats:
+				check(binary, [], fmt, tp, [value], fmt.replace('!r', '').replace('!s', '').format(text))
+			for fmt in ['{:x}', '{:_=6000}', '{:+}']:
+				check(binary, [], fmt, tp, [value], None)
+	sys.stdout.write("\n")
+
+# word has a formatter<Word> with the custom spec letters U (upper), L (lower) and R (reverse)
+def word_actions(spec,value):
+	for action in spec:
+		value = value.upper() if action == 'U' else value.lower() if action == 'L' else value[::-1]
+	return value
+
+# fmt has only custom specs, or standard specs without conversions
+def word_result(fmt,value):
+	def field(m):
+		spec = m.group(1)
+		return word_actions(spec, value) if re.match(r'^[ULR]+$', spec) else format(value, spec)
+	return re.sub(r'{\d*:?([^}]*)}', field, fmt)
+
+word_values = ['HeLLo', '', 'a b']
+word_std_formats = ['{}', '{:_>12}', '{:_<12}', '{:_^11}', '{:12}', '{!r:_>12}', '{!s:_^3}']
+word_custom_formats = ['{:U}', '{:L}', '{:R}', '{:UR}', '{:RLRU}', '{0:U}|{0:R}|{0}|{0:_>9}']
+
+# typed formats of built-in types are the same as untyped ones
+typed_cases = [
+	('std::int32_t', ['{}', '{:_>+10,}', '{0:x} {0:_^9}', '{!r:_<9}'], [-23, 1000]),
+	('double',       ['{}', '{:.3e}', '{:_^+16,.2f}'],               [-1234.56789, 0.0]),
+	('std::string',  ['{}', '{!r:_^12}', '{0:_>9} {0}'],              str_values),
+]
+
+def run_formatter_tests(binary):
+	for value in word_values:
+		for fmt in word_std_formats:
+			expected = fmt.replace('!r', '').replace('!s', '').format(value)
+			check(binary, [], fmt, 'word', [value], expected)
+			check(binary, ['--typed'], fmt, 'word', [value], expected)
+		for fmt in word_custom_formats:
+			check(binary, ['--typed'], fmt, 'word', [value], word_result(fmt, value))
+			# only typed formats accept custom specs
+			check(binary, [], fmt, 'word', [value], None)
+		# the formatter rejects the spec
+		for fmt in ['{:Q}', '{:U_}', '{:_>12U}']:
+			check(binary, ['--typed'], fmt, 'word', [value], None)
+
+	for tp, formats, values in typed_cases:
+		for fmt in formats:
+			for value in values:
+				svalue, pyres = expected_result(tp, fmt, value)
+				check(binary, ['--typed'], fmt, tp, [svalue], pyres)
+
+	# built-in types have no custom specs
+	for tp, value in [('int', '5'), ('double', '1.5'), ('bool', 'true'), ('char', 'c'), ('std::string', 'foo'), ('char[]', 'foo'), ('streamed', 'foo')]:
+		for fmt in ['{:U}', '{:5q}', '{:foo}', '{:_>+10,U}']:
+			check(binary, [], fmt, tp, [value], None)
+			check(binary, ['--typed'], fmt, tp, [value], None)
+	sys.stdout.write("\n")
+
+# The value of a decimal string in a binary floating point type with the given number of
+# significand digits and std::numeric_limits<>::min_exponent, rounded to nearest even.
+def round_binary(x,digits,min_exp):
+	if x == 0:
+		return x
+	scale = Fraction(2)**(digits - max(binary_exponent(x) + 1, min_exp))
+	return Fraction(round(x * scale)) / scale
+
+# e with 2**e <= x < 2**(e + 1)
+def binary_exponent(x):
+	exp = x.numerator.bit_length() - x.denominator.bit_length()
+	return exp if Fraction(2)**exp <= x else exp - 1
+
+# The 'a' presentation type without sign, like printf's %a but with a leading 1 (0 for zero
+# and subnormal numbers). Without a precision all significant hex digits are written,
+# otherwise they are rounded to nearest even or padded with zeros.
+def hex_float(x,digits,min_exp,precision,alt):
+	nibbles = (digits + 2) // 4
+	lead, exp2, fraction = 0, 0, 0
+	if x != 0:
+		exp2 = max(binary_exponent(x), min_exp - 1)
+		significand = x / Fraction(2)**exp2 * 16**nibbles
+		assert significand.denominator == 1
+		lead, fraction = divmod(int(significand), 16**nibbles)
+	count, zeros = nibbles, 0
+	if precision is None:
+		while count > 0 and fraction % 16 == 0:
+			fraction //= 16
+			count -= 1
+	elif precision < nibbles:
+		count = precision
+		lead, fraction = divmod(round(Fraction(lead * 16**nibbles + fraction, 16**(nibbles - precision))), 16**precision)
+		if lead == 2:
+			lead, exp2 = 1, exp2 + 1
+	else:
+		zeros = precision - nibbles
+	return '0x%x%s%s%sp%+d' % (lead, '.' if count or zeros or alt else '', '%0*x' % (count, fraction) if count else '', '0' * zeros, exp2)
+
+# the exact value of printed hex float digits
+def parse_hex_float(s):
+	m = re.match(r'^([+\- ]?)0[xX]([0-9a-fA-F])\.?([0-9a-fA-F]*)[pP]([+-]\d+)$', s)
+	if m is None:
+		return None
+	sign, lead, fraction, exp = m.groups()
+	value = (int(lead + fraction, 16) * Fraction(2)**int(exp)) / 16**len(fraction)
+	return -value if sign == '-' else value
+
+hexfloat_types = [
+	('float', 24, -125, [
+		'0', '-0', '1', '-1', '0.1', '-2.5', '0.001', '1234.5678', '65504', '3.4028234663852886e38',
+		'1.1754943508222875e-38', '1e-40', '-1.4e-45', 'inf', '-inf', 'nan', '-nan']),
+	('double', 53, -1021, [
+		'0', '-0', '1', '-1', '0.1', '-2.5', '0.001', '1234.56789', '1e300', '1.7976931348623157e308',
+		'2.2250738585072014e-308', '1e-310', '-5e-324', 'inf', '-inf', 'nan', '-nan']),
+	('long double', 64, -16381, [
+		'0', '-0', '1', '-1', '0.1', '-2.5', '0.001', '1234.56789', '1e300', '1.18973149535723176502e4932',
+		'3.36210314311209350626e-4932', '1e-4940', '-4e-4951', 'inf', '-inf', 'nan', '-nan']),
+]
+
+hexfloat_fill_aligns = [''] + [fill + align for fill in ['_', '0', ' ', '*'] for align in ['<', '>', '=', '^']]
+
+# (fill+align, sign, alt, width, precision, type)
+hexfloat_specs = \
+	[(align, sign, '', width, '', tp) for align in hexfloat_fill_aligns for sign in signs for width in ['', '1', '30'] for tp in 'aA'] + \
+	[('', sign, '', '030', '', tp) for sign in signs for tp in 'aA'] + \
+	[('', '', alt, '', prec, tp) for prec in ['.0', '.1', '.3', '.5', '.13', '.15', '.16', '.20'] for alt in alts for tp in 'aA'] + \
+	[('_^', '+', '#', '40', '.3', 'a'), ('0=', ' ', '', '40', '.20', 'A')]
+
+def hexfloat_result(svalue,digits,min_exp,align,sign,alt,width,prec,tp):
+	negative = svalue.startswith('-')
+	prefix = '-' if negative else sign if sign in ('+', ' ') else ''
+	if svalue.lstrip('-') in ('inf', 'nan'):
+		body = svalue.lstrip('-')
+	else:
+		x = round_binary(Fraction(svalue.lstrip('-')), digits, min_exp)
+		body = hex_float(x, digits, min_exp, int(prec[1:]) if prec else None, alt == '#')
+		prefix += body[:2]
+		body = body[2:]
+	if tp == 'A':
+		prefix, body = prefix.upper(), body.upper()
+	fill, align = (align[0], align[1]) if align else ('0', '=') if width.startswith('0') else (' ', '>')
+	padding = max(int(width or 0) - len(prefix) - len(body), 0)
+	if align == '<':
+		return prefix + body + fill * padding
+	elif align == '>':
+		return fill * padding + prefix + body
+	elif align == '=':
+		return prefix + fill * padding + body
+	else:
+		return fill * (padding // 2) + prefix + body + fill * (padding - padding // 2)
+
+def run_hexfloat_tests(binary):
+	for tp, digits, min_exp, values in hexfloat_types:
+		for svalue in values:
+			for spec in hexfloat_specs:
+				fmt = '{:%s}' % ''.join(spec)
+				check(binary, [], fmt, tp, [svalue], hexfloat_result(svalue, digits, min_exp, *spec))
+			# all digits read back as the same value
+			if svalue.lstrip('-') not in ('inf', 'nan'):
+				status, cppres, error = run_binary(binary, ['{:a}', tp, svalue])
+				value = parse_hex_float(cppres)
+				expected = round_binary(Fraction(svalue.lstrip('-')), digits, min_exp)
+				report(status == 0 and value is not None and abs(value) == expected, "%s %r round trip" % (tp, svalue), "%s == %s" % (cppres, hex_float(expected, digits, min_exp, None, False)))
+	sys.stdout.write("\n")
+
+# The variants of the vector code the library selects from. A CPU without AVX2 runs
+# the SSE2 code for 'avx2'.
+simd_levels = ['scalar', 'sse2', 'avx2']
+
+# 64 bit integers with more than 8 digits convert their low 16 digits at once
+def long_decimals(limit,signed):
+	values = [limit]
+	x = 1
+	for digits in range(8, len(str(limit))):
+		x = (x * 6364136223846793005 + 1442695040888963407) % 2**64
+		values += [value for value in [10**digits - 1, 10**digits, 10**digits + x % 10**digits] if value <= limit]
+	return [-value if signed and i % 2 else value for i, value in enumerate(values)]
+
+simd_decimal_cases = [
+	('unsigned long long', long_decimals(2**64 - 1, False)),
+	('std::int64_t',       long_decimals(2**63 - 1, True) + [-(2**63 - 1)]),
+	('__int128',           long_decimals(2**127 - 1, True) + [-(2**127 - 1)]),
+]
+
+simd_decimal_formats = ['{}', '{:,}', '{:_}', '{:+}', '{:_>30}', '{:030,}']
+
+def run_simd_decimal_tests(binary):
+	for simd in simd_levels:
+		for tp, values in simd_decimal_cases:
+			for fmt in simd_decimal_formats:
+				for value in values:
+					check(binary, [], fmt, tp, [str(value)], fmt.format(value), simd)
+			if tp != '__int128':
+				for spec in ['', ',']:
+					check(binary, ['--each=, '], spec, tp + '[]', [str(value) for value in values], ', '.join(format(value, spec) for value in values), simd)
+	sys.stdout.write("\n")
+
+# repr of a string with bytes: '?' is only escaped in front of another '?' (trigraphs)
+def repr_bytes(value):
+	buf = ['"']
+	for index, c in enumerate(value):
+		if c == '?':
+			buf.append('?\\' if value[index + 1:index + 2] == '?' else '?')
+		else:
+			buf.append(STR_REPR.get(c, c))
+	buf.append('"')
+	return ''.join(buf)
+
+# Strings around the 16 and 32 byte vector widths, with bytes >= 0x80 and one special
+# character (or a byte only the vector code flags) at the start, middle or end.
+def escape_scan_values():
+	values = []
+	for length in [0, 1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100]:
+		base = ''.join(chr(0x80 + index * 7 % 128) if index % 5 == 4 else chr(0x61 + index % 26) for index in range(length))
+		values.append(base)
+		for special in ['\0', '\a', '\t', '\n', '\r', '"', '\\', '??', '\x01', '\x0e', '\x7f', '\x80', '\xff']:
+			for pos in sorted(set([0, length // 2, max(length - 1, 0)])):
+				values.append(base[:pos] + special + base[pos + 1:])
+	return values
+
+def run_simd_escape_tests(binary):
+	values = escape_scan_values()
+	for simd in simd_levels:
+		for fmt in ['{!r}', '{!r:_^120}']:
+			for value in values:
+				check(binary, ['--escaped'], fmt, 'std::string', [escape_arg(value)], fmt.replace('!r', '').format(repr_bytes(value)), simd)
+	sys.stdout.write("\n")
+
+extra_tests = [
+	run_to_n_tests,
+	run_size_tests,
+	run_cache_tests,
+	run_each_int_tests,
+	run_each_float_tests,
+	run_nul_tests,
+	run_container_tests,
+	run_conversion_tests,
+	run_fallback_tests,
+	run_formatter_tests,
+	run_hexfloat_tests,
+	run_simd_decimal_tests,
+	run_simd_escape_tests,
+]
 
 def run_tests(binary):
 	for tp, values, formats in testcases:
@@ -224,5 +766,11 @@ def run_tests(binary):
 				run_test(binary,tp,fmt,value)
 		sys.stdout.write("\n")
 
+	for run in extra_tests:
+		run(binary)
+
 if __name__ == '__main__':
 	run_tests(sys.argv[1])
+	if failed:
+		sys.stdout.write("%d tests failed\n" % failed)
+		sys.exit(1)